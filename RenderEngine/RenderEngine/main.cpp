@@ -5,6 +5,10 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cerrno>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -16,10 +20,25 @@
 #include "src/graphics/window.h"
 #include "src/graphics/camera.h"
 #include "src/graphics/shader.h"
+#include "src/graphics/shadercache.h"
+#include "src/graphics/shaderlibrary.h"
+#include "src/graphics/glstate.h"
 
 #include "src/graphics/buffers/vertexarray.h"
 #include "src/graphics/buffers/vertexbuffer.h"
 #include "src/graphics/buffers/indexbuffer.h"
+#include "src/graphics/buffers/ringbuffer.h"
+#include "src/graphics/buffers/geometrypool.h"
+#include "src/graphics/texturepool.h"
+#include "src/graphics/uniformblocks.h"
+#include "src/graphics/drawtransforms.h"
+#include "src/graphics/renderqueue.h"
+#include "src/graphics/frustum.h"
+#include "src/graphics/lighting/lightmanager.h"
+#include "src/graphics/lighting/clustergrid.h"
+#include "src/graphics/deferred/deferredrenderer.h"
+#include "src/graphics/shadows/cascadedshadowmap.h"
+#include "src/graphics/shadows/pointshadowmap.h"
 
 #include "src/graphics/mesh.h"
 #include "src/graphics/model.h"
@@ -29,122 +48,110 @@ using namespace graphics;
 // settings
 #define SCR_WIDTH 800.0f
 #define SCR_HEIGHT 600.0f
+// lamps drawn as cubes, they are the first NR_POINT_LIGHTS of NR_SCENE_LIGHTS point lights
+#define NR_POINT_LIGHTS 4
+#define NR_SCENE_LIGHTS 1024
+// upper bound of --crowd, every instance costs a transform in the instance ring
+#define MAX_CROWD 100000
 
-int main()
+int main(int argc, char* argv[])
 {
+// renderer, forward (clustered) by default, --deferred for the G-buffer path.
+// --crowd N adds a field of N more nanosuits, drawn instanced in one call per mesh.
+// --compact-vertices stores the models quantized, 20 instead of 56 bytes per vertex
+bool useDeferred = false;
+bool compactVertices = false;
+unsigned int crowdSize = 0;
+for (int i = 1; i < argc; i++)
+{
+	std::string arg = argv[i];
+	if (arg == "--deferred")
+		useDeferred = true;
+	else if (arg == "--crowd")
+	{
+		if (i + 1 >= argc)
+		{
+			std::cout << "ERROR::MAIN::CROWD_MISSING_COUNT" << std::endl;
+			continue;
+		}
+		const char* value = argv[++i];
+		char* end = nullptr;
+		errno = 0;
+		unsigned long count = std::strtoul(value, &end, 10);
+		// strtoul takes "-1" as ULONG_MAX, only plain digits are a count
+		if (value[0] < '0' || value[0] > '9' || *end != '\0' || errno == ERANGE)
+		{
+			std::cout << "ERROR::MAIN::CROWD_INVALID_COUNT " << value << std::endl;
+			continue;
+		}
+		if (count > MAX_CROWD)
+		{
+			std::cout << "ERROR::MAIN::CROWD_TOO_LARGE " << count << ", clamped to " << MAX_CROWD << std::endl;
+			count = MAX_CROWD;
+		}
+		crowdSize = (unsigned int)count;
+	}
+	else if (arg == "--compact-vertices")
+		compactVertices = true;
+}
+
 // Init glfw, glad and window context
 // -----------------------------------
 Window window("Learn OpenGL", SCR_WIDTH, SCR_HEIGHT);
+std::cout << "Renderer: " << (useDeferred ? "deferred" : "forward") << std::endl;
 
 
 // build and compile our shader program
 // ------------------------------------
-
-Shader* ourModelShader = new Shader("resources/shaders/model.vs", "resources/shaders/model.fs");
-Shader* lampShader = new Shader("resources/shaders/lamp.vs", "resources/shaders/lamp.fs");
+// programs are submitted up front and compile in parallel, draws are skipped until they're ready.
+// the model program is a family of permutations, one per light setup and material texture set
+ShaderLibrary* modelShaders = new ShaderLibrary("resources/shaders/model.vs", "resources/shaders/model.fs", nullptr, true);
+Shader* lampShader = new Shader("resources/shaders/lamp.vs", "resources/shaders/lamp.fs", nullptr, true);
+
+// lights used by this scene, anything not listed here is compiled out of model.fs
+ShaderDefines sceneDefines;
+sceneDefines.set("USE_DIR_LIGHT", 1);
+sceneDefines.set("USE_CLUSTERED_LIGHTS", 1);
+sceneDefines.set("USE_SPOT_LIGHT", 1);
+sceneDefines.set("USE_SHADOWS", 1);
+sceneDefines.set("USE_POINT_SHADOWS", 1);
 
 // set up vertex data (and buffer(s)) and configure vertex attributes
 // ------------------------------------------------------------------
-float verticesPosition[] = {
-	-0.5f, -0.5f, -0.5f,
-	0.5f, -0.5f, -0.5f,
-	0.5f,  0.5f, -0.5f,
-	-0.5f,  0.5f, -0.5f,
-
-	-0.5f, -0.5f,  0.5f,
-	0.5f, -0.5f,  0.5f,
-	0.5f,  0.5f,  0.5f,
-	-0.5f,  0.5f,  0.5f,
-
-	-0.5f,  0.5f,  0.5f,
-	-0.5f,  0.5f, -0.5f,
-	-0.5f, -0.5f, -0.5f,
-	-0.5f, -0.5f,  0.5f,
-
-	0.5f,  0.5f,  0.5f,
-	0.5f,  0.5f, -0.5f,
-	0.5f, -0.5f, -0.5f,
-	0.5f, -0.5f,  0.5f,
-
-	-0.5f, -0.5f, -0.5f,
-	0.5f, -0.5f, -0.5f,
-	0.5f, -0.5f,  0.5f,
-	-0.5f, -0.5f,  0.5f,
-
-	-0.5f,  0.5f, -0.5f,
-	0.5f,  0.5f, -0.5f,
-	0.5f,  0.5f,  0.5f,
-	-0.5f,  0.5f,  0.5f
+// cube of the lamps, one interleaved vertex per row: position, normal, texture coords
+float cubeVertices[] = {
+	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
+	 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
+	-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
+
+	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
+	-0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
+
+	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+	-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+	-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+
+	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
+	 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
+	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
+	 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
+
+	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
+	 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
+	-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
+
+	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
+	-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f
 };
 
-float verticesNormal[] = {
-
-	0.0f,  0.0f, -1.0f,
-	0.0f,  0.0f, -1.0f,
-	0.0f,  0.0f, -1.0f,
-	0.0f,  0.0f, -1.0f,
-
-	0.0f,  0.0f,  1.0f,
-	0.0f,  0.0f,  1.0f,
-	0.0f,  0.0f,  1.0f,
-	0.0f,  0.0f,  1.0f,
-
-	-1.0f,  0.0f,  0.0f,
-	-1.0f,  0.0f,  0.0f,
-	-1.0f,  0.0f,  0.0f,
-	-1.0f,  0.0f,  0.0f,
-
-	1.0f,  0.0f,  0.0f,
-	1.0f,  0.0f,  0.0f,
-	1.0f,  0.0f,  0.0f,
-	1.0f,  0.0f,  0.0f,
-
-	0.0f, -1.0f,  0.0f,
-	0.0f, -1.0f,  0.0f,
-	0.0f, -1.0f,  0.0f,
-	0.0f, -1.0f,  0.0f,
-
-	0.0f,  1.0f,  0.0f,
-	0.0f,  1.0f,  0.0f,
-	0.0f,  1.0f,  0.0f,
-	0.0f,  1.0f,  0.0f
-};
-
-
-float verticesTextureCoord[] = {
-	// texture coords
-	0.0f,  0.0f,
-	1.0f,  0.0f,
-	1.0f,  1.0f,
-	0.0f,  1.0f,
-
-	0.0f,  0.0f,
-	1.0f,  0.0f,
-	1.0f,  1.0f,
-	0.0f,  1.0f,
-
-	1.0f,  0.0f,
-	1.0f,  1.0f,
-	0.0f,  1.0f,
-	0.0f,  0.0f,
-
-	1.0f,  0.0f,
-	1.0f,  1.0f,
-	0.0f,  1.0f,
-	0.0f,  0.0f,
-
-	0.0f,  1.0f,
-	1.0f,  1.0f,
-	1.0f,  0.0f,
-	0.0f,  0.0f,
-
-	0.0f,  1.0f,
-	1.0f,  1.0f,
-	1.0f,  0.0f,
-	0.0f,  0.0f
-};
-
-unsigned int indices[6 * 6];
+unsigned char indices[6 * 6];
 
 for (int i = 0; i < 6; i++)
 {
@@ -165,13 +172,90 @@ glm::vec3 pointLightPositions[] = {
 	glm::vec3(0.0f,  0.0f, -3.0f)
 };
 
+// per-frame and per-pass constants are written straight into a persistently mapped ring,
+// every block is bound as a range of it at its fixed binding point
+RingBuffer* constants = new RingBuffer(GL_UNIFORM_BUFFER, 64 * 1024);
+// per-instance transforms and draw records of every draw, a storage buffer so one range holds
+// any number of them
+RingBuffer* instances = new RingBuffer(GL_SHADER_STORAGE_BUFFER, 64 * 1024 + crowdSize * sizeof(DrawBlock));
+// scene draws are queued, sorted by program, material and mesh and merged into multi draws
+RenderQueue* queue = new RenderQueue();
+// every model mesh lives in one set of vertex and index buffers
+GeometryPool* geometry = new GeometryPool(compactVertices ? COMPACT_VERTICES : FULL_VERTICES);
+// and every material map in array textures, so meshes with different maps still batch
+TexturePool* textures = new TexturePool();
+// forward: light lists per cluster, rebuilt every frame on the CPU.
+// deferred: G-buffer plus full-screen and light volume passes
+ClusterGrid* clusters = useDeferred ? nullptr : new ClusterGrid(NR_SCENE_LIGHTS, 128 * 1024);
+DeferredRenderer* deferred = useDeferred ? new DeferredRenderer((unsigned int)SCR_WIDTH, (unsigned int)SCR_HEIGHT, true) : nullptr;
+ShaderLibrary* sceneShaders = useDeferred ? deferred->getGeometryShaders() : modelShaders;
+// directional light shadows for both paths
+CascadedShadowMap* shadows = new CascadedShadowMap(2048, 50.0f, true, geometry->getFormat());
+// and a cube per lamp
+PointShadowMap* pointShadows = new PointShadowMap(NR_POINT_LIGHTS, 512, true, geometry->getFormat());
+
+CameraBlock camera;
+LightsBlock lights;
+// directional light
+lights.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+lights.dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+lights.dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+lights.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+// point lights, only the ones inside the view frustum reach the GPU each frame
+LightManager* lightManager = new LightManager(NR_SCENE_LIGHTS);
+for (unsigned int i = 0; i < NR_POINT_LIGHTS; i++)
+{
+	lightManager->addPointLight(pointLightPositions[i], glm::vec3(0.05f), glm::vec3(0.8f), glm::vec3(1.0f), 1.0f, i == 0 ? 0.09f : 0.29f, 0.032f);
+	lightManager->setShadowIndex(i, i);
+}
+// plus a field of small colored lights around the model
+unsigned int seed = 1;
+for (unsigned int i = NR_POINT_LIGHTS; i < NR_SCENE_LIGHTS; i++)
+{
+	float r[6];
+	for (int j = 0; j < 6; j++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		r[j] = (seed >> 8) / 16777216.0f;
+	}
+	glm::vec3 color = 0.3f * glm::vec3(r[3], r[4], r[5]);
+	lightManager->addPointLight(glm::vec3(-8.0f + 16.0f * r[0], -3.0f + 6.0f * r[1], -14.0f + 18.0f * r[2]),
+		glm::vec3(0.0f), color, color, 1.0f, 0.7f, 8.0f);
+}
+// spotLight, position and direction follow the camera every frame
+lights.spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+lights.spotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+lights.spotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+lights.spotLight.constant = 1.0f;
+lights.spotLight.linear = 0.29f;
+lights.spotLight.quadratic = 0.032f;
+lights.spotLight.cutOff = glm::cos(glm::radians(12.5f));
+lights.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+
+BufferLayout cubeLayout;
+cubeLayout.add("aPos", 0, 3).add("aNormal", 1, 3).add("aTexCoords", 2, 2);
 VertexArray* lightVAO = new VertexArray();
-lightVAO->addVertexBuffer(new VertexBuffer(verticesPosition, 4 * 6, 3), 0);
+lightVAO->addBuffer(new VertexBuffer(cubeVertices, 4 * 6, cubeLayout), cubeLayout);
+// color of every lamp, streamed from its light once per frame
+VertexBuffer* lampColors = new VertexBuffer(nullptr, NR_POINT_LIGHTS, 3, STREAM_BUFFER);
+lightVAO->addInstanceBuffer(lampColors, 3);
 IndexBuffer* IBO = new IndexBuffer(indices, 6 * 6, 3);
 
 // load models
 // -----------
-Model* ourModel = new Model("resources/models/nanosuit/nanosuit.obj");
+Model* ourModel = new Model("resources/models/nanosuit/nanosuit.obj", geometry, textures);
+ourModel->prepareShaders(sceneShaders, sceneDefines);
+// the crowd stands in rows behind the model and doesn't cast shadows
+std::vector<glm::mat4> crowd(crowdSize);
+for (unsigned int i = 0; i < crowdSize; i++)
+{
+	glm::vec3 position(-62.5f + 2.5f * (i % 50), -1.75f, -8.0f - 2.5f * (i / 50));
+	crowd[i] = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.2f));
+}
+std::cout << "Model permutations: " << sceneShaders->getPermutationCount() << std::endl;
+geometry->printStats();
+textures->printStats();
+ShaderCache::printStats();
 
 
 // render loop
@@ -184,110 +268,139 @@ window.processInput();
 
 window.clear();
 
-ourModelShader->enable();
-// be sure to activate shader when setting uniforms/drawing objects
-ourModelShader->setVec3("viewPos", window.GetCamPos());
-ourModelShader->setFloat("material.shininess", 32.0f);
-
-/*
-Here we set all the uniforms for the 5/6 types of lights we have. We have to set them manually and index
-the proper PointLight struct in the array to set each uniform variable. This can be done more code-friendly
-by defining light types as classes and set their values in there, or by using a more efficient uniform approach
-by using 'Uniform buffer objects', but that is something we'll discuss in the 'Advanced GLSL' tutorial.
-*/
-// directional light
-ourModelShader->setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-ourModelShader->setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-ourModelShader->setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-ourModelShader->setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-// point light 1
-ourModelShader->setVec3("pointLights[0].position", pointLightPositions[0]);
-ourModelShader->setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-ourModelShader->setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-ourModelShader->setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-ourModelShader->setFloat("pointLights[0].constant", 1.0f);
-ourModelShader->setFloat("pointLights[0].linear", 0.09);
-ourModelShader->setFloat("pointLights[0].quadratic", 0.032);
-// point light 2
-ourModelShader->setVec3("pointLights[1].position", pointLightPositions[1]);
-ourModelShader->setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-ourModelShader->setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-ourModelShader->setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-ourModelShader->setFloat("pointLights[1].constant", 1.0f);
-ourModelShader->setFloat("pointLights[1].linear", 0.29);
-ourModelShader->setFloat("pointLights[1].quadratic", 0.032);
-// point light 3
-ourModelShader->setVec3("pointLights[2].position", pointLightPositions[2]);
-ourModelShader->setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-ourModelShader->setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-ourModelShader->setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-ourModelShader->setFloat("pointLights[2].constant", 1.0f);
-ourModelShader->setFloat("pointLights[2].linear", 0.29);
-ourModelShader->setFloat("pointLights[2].quadratic", 0.032);
-// point light 4
-ourModelShader->setVec3("pointLights[3].position", pointLightPositions[3]);
-ourModelShader->setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-ourModelShader->setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-ourModelShader->setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-ourModelShader->setFloat("pointLights[3].constant", 1.0f);
-ourModelShader->setFloat("pointLights[3].linear", 0.29);
-ourModelShader->setFloat("pointLights[3].quadratic", 0.032);
-// spotLight
-ourModelShader->setVec3("spotLight.position", window.GetCamPos());
-ourModelShader->setVec3("spotLight.direction", window.GetCamFront());
-ourModelShader->setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-ourModelShader->setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-ourModelShader->setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-ourModelShader->setFloat("spotLight.constant", 1.0f);
-ourModelShader->setFloat("spotLight.linear", 0.29);
-ourModelShader->setFloat("spotLight.quadratic", 0.032);
-
-ourModelShader->setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-ourModelShader->setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-
 // view/projection transformations
 glm::mat4 projection = glm::perspective(glm::radians(window.GetCamZoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 glm::mat4 view = window.GetCamViewMatrix();
-ourModelShader->setMat4("projection", projection);
-ourModelShader->setMat4("view", view);
+
+// waits only if the GPU is still reading the constants written three frames ago
+constants->beginFrame();
+instances->beginFrame();
+
+// per-frame camera and light data, one write each for every program
+camera.view = view;
+camera.projection = projection;
+camera.viewPos = window.GetCamPos();
+// out of space keeps the frame on the previous binding, push reports it
+int cameraOffset = constants->push(&camera, sizeof(CameraBlock));
+if (cameraOffset >= 0)
+	constants->bindRange(CAMERA_BLOCK_BINDING, cameraOffset, sizeof(CameraBlock));
+
+// point lights outside the frustum are dropped before anything is uploaded
+lightManager->cull(Frustum(projection * view));
+lightManager->upload();
+
+lights.spotLight.position = window.GetCamPos();
+lights.spotLight.direction = window.GetCamFront();
+lights.pointLightCount = lightManager->getVisibleCount();
+int lightsOffset = constants->push(&lights, sizeof(LightsBlock));
+if (lightsOffset >= 0)
+	constants->bindRange(LIGHTS_BLOCK_BINDING, lightsOffset, sizeof(LightsBlock));
 
 // render the loaded model
 glm::mat4 model(1.0);
 model = glm::translate(model, glm::vec3(0.0f, -1.75f, 0.0f)); // translate it down so it's at the center of the scene
 model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));	// it's a bit too big for our scene, so scale it down
-ourModelShader->setMat4("model", model);
 
-// draw the loaded model
-ourModel->Draw(ourModelShader);
-ourModelShader->disable();
+// shadow casters into the cascades that are due this frame, the far ones alternate. The model
+// is static, it is only redrawn when a cascade's cached layer no longer fits; dynamic casters
+// would follow in a DYNAMIC_CASTERS pass per cascade
+shadows->update(view, glm::radians(window.GetCamZoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f, lights.dirLight.direction);
+for (unsigned int c = 0; c < SHADOW_CASCADES; c++)
+	if (shadows->beginCascade(c, STATIC_CASTERS))
+		ourModel->DrawDepth(model, instances);
+shadows->endCascades((unsigned int)SCR_WIDTH, (unsigned int)SCR_HEIGHT);
+shadows->bindForReading(constants);
+
+// lamp cubes, one pass per lamp with the model routed only to the faces it can reach. The lamps
+// don't move, so after the first frame every cube comes from the static cache
+if (pointShadows->begin())
+{
+	glm::vec3 casterCenter;
+	float casterRadius;
+	ourModel->getBoundingSphere(model, casterCenter, casterRadius);
+	for (unsigned int i = 0; i < NR_POINT_LIGHTS; i++)
+		if (pointShadows->beginLight(i, lightManager->getPosition(i), lightManager->getRadius(i), STATIC_CASTERS) && pointShadows->beginCaster(casterCenter, casterRadius))
+			ourModel->DrawDepth(model, instances);
+	pointShadows->end((unsigned int)SCR_WIDTH, (unsigned int)SCR_HEIGHT);
+}
+pointShadows->bindForReading();
 
+// queue the loaded model, meshes whose permutation is still compiling are skipped this frame
+textures->bindMaterials();
+queue->begin(view, 100.0f, instances);
+ourModel->Submit(queue, sceneShaders, sceneDefines, &model, 1);
+if (crowdSize > 0)
+	ourModel->Submit(queue, sceneShaders, sceneDefines, &crowd[0], crowdSize);
 
-// also draw the lamp object(s)
-lampShader->enable();
-lightVAO->bind();
-IBO->bind();
-lampShader->setMat4("view", view);
-lampShader->setMat4("projection", projection);
-for (unsigned int i = 0; i < 4; i++)
+if (useDeferred)
 {
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, pointLightPositions[i]);
-	model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
-	lampShader->setMat4("model", model);
-	glDrawElements(GL_TRIANGLES, IBO->getPrimitiveCount()*IBO->getComponentCount(), GL_UNSIGNED_INT, 0);
+	deferred->beginGeometryPass();
+	queue->execute();
+	deferred->endGeometryPass();
+	deferred->lightingPass(projection * view, sceneDefines, lightManager->getVisibleCount(), constants);
+}
+else
+{
+	clusters->setProjection(glm::radians(window.GetCamZoom()), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f, SCR_WIDTH, SCR_HEIGHT);
+	clusters->build(view, lightManager->getVisibleLights(), lightManager->getVisibleCount(), constants);
+	queue->execute();
 }
 
-
-IBO->unbind();
-lightVAO->unbind();
-lampShader->disable();
+// also draw the lamp object(s)
+if (lampShader->isReady())
+{
+	lampShader->enable();
+	// every lamp is an instance of the same cube, one draw call for all of them
+	glm::mat4 lampModels[NR_POINT_LIGHTS];
+	for (unsigned int i = 0; i < NR_POINT_LIGHTS; i++)
+	{
+		lampModels[i] = glm::translate(glm::mat4(1.0f), pointLightPositions[i]);
+		lampModels[i] = glm::scale(lampModels[i], glm::vec3(0.2f)); // Make it a smaller cube
+	}
+	// the light's hue at full brightness
+	glm::vec3* colors = (glm::vec3*)lampColors->map();
+	if (colors != nullptr)
+	{
+		for (unsigned int i = 0; i < NR_POINT_LIGHTS; i++)
+		{
+			glm::vec3 diffuse = lightManager->getDiffuse(i);
+			colors[i] = diffuse / std::max(std::max(diffuse.r, diffuse.g), std::max(diffuse.b, 0.001f));
+		}
+		lampColors->commit();
+	}
+	if (DrawTransforms::push(lampModels, NR_POINT_LIGHTS, instances))
+		lightVAO->drawInstanced(IBO, NR_POINT_LIGHTS);
+	lampShader->disable();
+}
 
 // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 // -------------------------------------------------------------------------------
+constants->endFrame();
+instances->endFrame();
+lightManager->endFrame();
+if (clusters != nullptr)
+	clusters->endFrame();
+GLState::endFrame();
 window.update();
 }
 
+GLState::printStats();
+shadows->printStats();
+pointShadows->printStats();
+queue->printStats();
+
 delete ourModel;
-delete ourModelShader;
+delete geometry;
+delete textures;
+delete modelShaders;
+delete lampShader;
+delete clusters;
+delete deferred;
+delete shadows;
+delete pointShadows;
+delete queue;
+delete lightManager;
+delete constants;
+delete instances;
 return 0;
 }
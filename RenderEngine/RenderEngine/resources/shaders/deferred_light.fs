@@ -0,0 +1,261 @@
+#version 430 core
+// lighting passes of the deferred path. The full-screen pass shades the directional and spot
+// light, the LIGHT_VOLUME pass one point light per instance, added on top.
+out vec4 FragColor;
+
+#ifndef LIGHT_VOLUME
+#define LIGHT_VOLUME 0
+#endif
+#ifndef USE_DIR_LIGHT
+#define USE_DIR_LIGHT 1
+#endif
+#ifndef USE_SPOT_LIGHT
+#define USE_SPOT_LIGHT 1
+#endif
+#ifndef USE_SHADOWS
+#define USE_SHADOWS 0
+#endif
+// point lights with a shadowIndex sample the cubes PointShadowMap renders
+#ifndef USE_POINT_SHADOWS
+#define USE_POINT_SHADOWS 0
+#endif
+
+// light structs and blocks, identical to model.fs
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+    float radius;
+    int shadowIndex;            // cube of the PointShadowMap, -1 when unshadowed
+};
+
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 ambient;
+    float quadratic;
+    vec3 diffuse;
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
+};
+
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+layout (std140, binding = 1) uniform Lights
+{
+    DirLight dirLight;
+    SpotLight spotLight;
+    uint pointLightCount;
+};
+
+layout (std140, binding = 4) uniform Deferred
+{
+    mat4 invViewProjection;     // NDC back to world space
+    vec4 screenSize;            // width, height, 1 / width, 1 / height
+};
+
+#if USE_SHADOWS
+#define SHADOW_CASCADES 4
+layout (std140, binding = 5) uniform Shadows
+{
+    mat4 cascadeViewProjection[SHADOW_CASCADES];
+    vec4 cascadeSplits;         // view depth where each cascade ends
+    vec4 cascadeTexelSize;      // world size of one shadow texel in each cascade
+    vec4 shadowParams;          // normal offset in texels, depth bias, 1 / resolution
+};
+
+// one depth layer per cascade, compared in hardware, see CascadedShadowMap
+layout (binding = 8) uniform sampler2DArrayShadow shadowCascades;
+#endif
+
+#if USE_POINT_SHADOWS
+// cube per shadowed point light, distance over radius compared in hardware, see PointShadowMap
+layout (binding = 9) uniform samplerCubeArrayShadow pointShadowCubes;
+#endif
+
+#if LIGHT_VOLUME
+layout (std430, binding = 0) readonly buffer PointLightList
+{
+    PointLight pointLights[];
+};
+
+flat in int LightIndex;
+#endif
+
+// G-buffer, see GBufferUnit
+layout (binding = 0) uniform sampler2D gAlbedoSpec;
+layout (binding = 1) uniform sampler2D gNormalShininess;
+layout (binding = 2) uniform sampler2D gDepth;
+
+// surface read from the G-buffer, shared by every light
+vec3 albedo;
+vec3 specularColor;
+float shininess;
+
+vec3 DecodeNormal(vec2 encoded);
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcSpecular(vec3 lightDir, vec3 normal, vec3 viewDir);
+#if USE_SHADOWS
+float CalcShadow(vec3 fragPos, vec3 normal, vec3 lightDir);
+#endif
+#if USE_POINT_SHADOWS
+float CalcPointShadow(PointLight light, vec3 fragPos, vec3 normal);
+#endif
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    // nothing was drawn here, keep the clear color. Volumes reach the sky too: their back faces
+    // are depth clamped to the far plane, which passes the GEQUAL test against a cleared depth
+    if (depth == 1.0)
+        discard;
+
+    // world position from the depth buffer
+    vec4 ndc = vec4(gl_FragCoord.xy * screenSize.zw * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = invViewProjection * ndc;
+    vec3 fragPos = world.xyz / world.w;
+
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, texel, 0);
+    vec4 normalShininess = texelFetch(gNormalShininess, texel, 0);
+    albedo = albedoSpec.rgb;
+    specularColor = vec3(albedoSpec.a);
+    shininess = normalShininess.z * 256.0;
+    vec3 norm = DecodeNormal(normalShininess.xy);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 result = vec3(0.0);
+#if LIGHT_VOLUME
+    result += CalcPointLight(pointLights[LightIndex], norm, fragPos, viewDir);
+#else
+#if USE_DIR_LIGHT
+#if USE_SHADOWS
+    float shadow = CalcShadow(fragPos, norm, normalize(-dirLight.direction));
+#else
+    float shadow = 1.0;
+#endif
+    result += CalcDirLight(dirLight, norm, viewDir, shadow);
+#endif
+#if USE_SPOT_LIGHT
+    result += CalcSpotLight(spotLight, norm, fragPos, viewDir);
+#endif
+#endif
+
+    FragColor = vec4(result, 1.0);
+}
+
+// inverse of EncodeNormal in gbuffer.fs
+vec3 DecodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+vec3 CalcSpecular(vec3 lightDir, vec3 normal, vec3 viewDir)
+{
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    return spec * specularColor;
+}
+
+#if USE_SHADOWS
+// fraction of the directional light reaching fragPos, 1 beyond the last cascade
+float CalcShadow(vec3 fragPos, vec3 normal, vec3 lightDir)
+{
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = 0;
+    while (cascade < SHADOW_CASCADES && viewDepth > cascadeSplits[cascade])
+        cascade++;
+    if (cascade == SHADOW_CASCADES)
+        return 1.0;
+    // push the receiver off its surface by a few texels of its cascade, more at grazing angles
+    float slope = 1.0 - max(dot(normal, lightDir), 0.0);
+    vec3 offsetPos = fragPos + normal * (cascadeTexelSize[cascade] * shadowParams.x * slope);
+    vec4 lightPos = cascadeViewProjection[cascade] * vec4(offsetPos, 1.0);
+    vec3 coords = lightPos.xyz / lightPos.w * 0.5 + 0.5;
+    return texture(shadowCascades, vec4(coords.xy, float(cascade), coords.z - shadowParams.y));
+}
+#endif
+
+#if USE_POINT_SHADOWS
+// fraction of a point light reaching fragPos, 1 for lights without a cube
+float CalcPointShadow(PointLight light, vec3 fragPos, vec3 normal)
+{
+    if (light.shadowIndex < 0)
+        return 1.0;
+    // push the receiver off its surface by a texel, which spans 2 * distance / resolution
+    float distance = length(fragPos - light.position);
+    float texel = 2.0 * distance / float(textureSize(pointShadowCubes, 0).x);
+    vec3 toFrag = fragPos + normal * (1.5 * texel) - light.position;
+    return texture(pointShadowCubes, vec4(toFrag, float(light.shadowIndex)), length(toFrag) / light.radius);
+}
+#endif
+
+// the light functions below match model.fs
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
+{
+    vec3 lightDir = normalize(-light.direction);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * CalcSpecular(lightDir, normal, viewDir);
+    return (ambient + (diffuse + specular) * shadow);
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float falloff = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= falloff * falloff;
+#if USE_POINT_SHADOWS
+    float shadow = CalcPointShadow(light, fragPos, normal);
+#else
+    float shadow = 1.0;
+#endif
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * CalcSpecular(lightDir, normal, viewDir);
+    return (ambient + (diffuse + specular) * shadow) * attenuation;
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * CalcSpecular(lightDir, normal, viewDir);
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
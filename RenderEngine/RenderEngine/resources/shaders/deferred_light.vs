@@ -0,0 +1,49 @@
+#version 430 core
+// full-screen triangle, or with LIGHT_VOLUME one cube per point light instance
+#ifndef LIGHT_VOLUME
+#define LIGHT_VOLUME 0
+#endif
+
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+#if LIGHT_VOLUME
+layout (location = 0) in vec3 aPos;
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+    float radius;
+    int shadowIndex;            // cube of the PointShadowMap, -1 when unshadowed
+};
+
+layout (std430, binding = 0) readonly buffer PointLightList
+{
+    PointLight pointLights[];
+};
+
+flat out int LightIndex;
+#endif
+
+void main()
+{
+#if LIGHT_VOLUME
+    // unit cube scaled to enclose the light's radius
+    PointLight light = pointLights[gl_InstanceID];
+    LightIndex = gl_InstanceID;
+    gl_Position = projection * view * vec4(light.position + aPos * (2.0 * light.radius), 1.0);
+#else
+    // covers the screen with one triangle, no vertex buffer needed
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+#endif
+}
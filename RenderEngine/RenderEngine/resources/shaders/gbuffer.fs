@@ -0,0 +1,79 @@
+#version 430 core
+// geometry pass of the deferred path, see GBuffer for the layout
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormalShininess;
+
+// material permutation defines, same meaning as in model.fs
+#ifndef HAS_DIFFUSE_MAP
+#define HAS_DIFFUSE_MAP 1
+#endif
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+#ifndef HAS_NORMAL_MAP
+#define HAS_NORMAL_MAP 0
+#endif
+
+// layers of the maps bound below, see TexturePool. Every mesh of a batch shares the arrays
+// and picks its layers through the MaterialIndex of its draw
+struct Material {
+    int diffuseLayer;
+    int specularLayer;
+    int normalLayer;
+    float shininess;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+flat in uint MaterialIndex;
+#if HAS_NORMAL_MAP
+in mat3 TBN;
+#endif
+
+layout (std430, binding = 5) readonly buffer Materials
+{
+    Material materials[];
+};
+
+#if HAS_DIFFUSE_MAP
+layout (binding = 0) uniform sampler2DArray diffuseMaps;
+#endif
+#if HAS_SPECULAR_MAP
+layout (binding = 1) uniform sampler2DArray specularMaps;
+#endif
+#if HAS_NORMAL_MAP
+layout (binding = 2) uniform sampler2DArray normalMaps;
+#endif
+
+// octahedral encoding, a unit vector in two [0, 1] components
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 wrapped = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return (n.z >= 0.0 ? n.xy : wrapped) * 0.5 + 0.5;
+}
+
+void main()
+{
+    Material material = materials[MaterialIndex];
+#if HAS_NORMAL_MAP
+    vec3 norm = normalize(TBN * (texture(normalMaps, vec3(TexCoords, material.normalLayer)).rgb * 2.0 - 1.0));
+#else
+    vec3 norm = normalize(Normal);
+#endif
+#if HAS_DIFFUSE_MAP
+    vec3 albedo = texture(diffuseMaps, vec3(TexCoords, material.diffuseLayer)).rgb;
+#else
+    vec3 albedo = vec3(1.0);
+#endif
+    // specular is stored as a single intensity
+#if HAS_SPECULAR_MAP
+    float specular = dot(texture(specularMaps, vec3(TexCoords, material.specularLayer)).rgb, vec3(0.299, 0.587, 0.114));
+#else
+    float specular = 0.0;
+#endif
+
+    gAlbedoSpec = vec4(albedo, specular);
+    gNormalShininess = vec4(EncodeNormal(norm), material.shininess / 256.0, 0.0);
+}
@@ -1,7 +1,9 @@
 #version 430 core
 out vec4 FragColor;
 
+in vec3 Color;
+
 void main()
 {
-    FragColor = vec4(1.0); // set alle 4 vector values to 1.0
+    FragColor = vec4(Color, 1.0);
 }
\ No newline at end of file
@@ -1,11 +1,29 @@
 #version 430 core
 layout (location = 0) in vec3 aPos;
+layout (location = 3) in vec3 aColor;    // per instance, the color of the lamp's light
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+out vec3 Color;
+
+struct Instance {
+    mat4 model;
+    mat3 normalMatrix;          // transpose(inverse(mat3(model))), built on the CPU
+};
+
+// transforms of every instance of the draw, indexed by gl_InstanceID
+layout (std430, binding = 3) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    Color = aColor;
+    gl_Position = projection * view * instances[gl_InstanceID].model * vec4(aPos, 1.0);
 }
\ No newline at end of file
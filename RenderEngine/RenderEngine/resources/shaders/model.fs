@@ -1,15 +1,49 @@
 #version 430 core
 out vec4 FragColor;
 
+// permutation defines, injected by the engine after #version. The defaults below
+// give the full shader; every feature switched off is compiled out entirely.
+#ifndef HAS_DIFFUSE_MAP
+#define HAS_DIFFUSE_MAP 1
+#endif
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+#ifndef HAS_NORMAL_MAP
+#define HAS_NORMAL_MAP 0
+#endif
+#ifndef USE_DIR_LIGHT
+#define USE_DIR_LIGHT 1
+#endif
+#ifndef USE_SPOT_LIGHT
+#define USE_SPOT_LIGHT 1
+#endif
+// point lights come from the cluster lists built by ClusterGrid instead of the Lights block
+#ifndef USE_CLUSTERED_LIGHTS
+#define USE_CLUSTERED_LIGHTS 0
+#endif
+// directional light shadowed by the cascades CascadedShadowMap renders
+#ifndef USE_SHADOWS
+#define USE_SHADOWS 0
+#endif
+// point lights with a shadowIndex sample the cubes PointShadowMap renders
+#ifndef USE_POINT_SHADOWS
+#define USE_POINT_SHADOWS 0
+#endif
+
+// layers of the maps bound below, see TexturePool. Every mesh of a batch shares the arrays
+// and picks its layers through the MaterialIndex of its draw
 struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
+    int diffuseLayer;
+    int specularLayer;
+    int normalLayer;
     float shininess;
-}; 
+};
 
+// std140 blocks shared by every program, mirrored by the structs in uniformblocks.h.
+// vec3 members are paired with a float to fill one 16 byte slot each.
 struct DirLight {
     vec3 direction;
-	
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
@@ -17,86 +51,244 @@ struct DirLight {
 
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-	
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
+    float radius;
+    int shadowIndex;            // cube of the PointShadowMap, -1 when unshadowed
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-  
     float constant;
+    vec3 direction;
     float linear;
-    float quadratic;
-  
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
-    vec3 specular;       
+    float cutOff;
+    vec3 specular;
+    float outerCutOff;
 };
 
-#define NR_POINT_LIGHTS 4
-
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+flat in uint MaterialIndex;
+#if HAS_NORMAL_MAP
+in mat3 TBN;
+#endif
+
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+layout (std140, binding = 1) uniform Lights
+{
+    DirLight dirLight;
+    SpotLight spotLight;
+    uint pointLightCount;
+};
+
+// the point lights inside the view frustum this frame, uploaded by the LightManager
+layout (std430, binding = 0) readonly buffer PointLightList
+{
+    PointLight pointLights[];
+};
+
+#if USE_CLUSTERED_LIGHTS
+layout (std140, binding = 3) uniform Clusters
+{
+    uvec4 clusterGrid;      // clusters along x, y and z, w = number of lights
+    vec4 clusterParams;     // tile size in pixels, depth slice scale and bias
+};
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform Material material;
+// offset into clusterLightIndices and light count of each cluster, the indices refer to pointLights
+layout (std430, binding = 1) readonly buffer ClusterRanges
+{
+    uvec2 clusterRanges[];
+};
+
+layout (std430, binding = 2) readonly buffer ClusterLightIndices
+{
+    uint clusterLightIndices[];
+};
+#endif
+
+#if USE_SHADOWS
+#define SHADOW_CASCADES 4
+layout (std140, binding = 5) uniform Shadows
+{
+    mat4 cascadeViewProjection[SHADOW_CASCADES];
+    vec4 cascadeSplits;         // view depth where each cascade ends
+    vec4 cascadeTexelSize;      // world size of one shadow texel in each cascade
+    vec4 shadowParams;          // normal offset in texels, depth bias, 1 / resolution
+};
+
+// one depth layer per cascade, compared in hardware, see CascadedShadowMap
+layout (binding = 8) uniform sampler2DArrayShadow shadowCascades;
+#endif
+
+#if USE_POINT_SHADOWS
+// cube per shadowed point light, distance over radius compared in hardware, see PointShadowMap
+layout (binding = 9) uniform samplerCubeArrayShadow pointShadowCubes;
+#endif
+
+layout (std430, binding = 5) readonly buffer Materials
+{
+    Material materials[];
+};
+
+#if HAS_DIFFUSE_MAP
+layout (binding = 0) uniform sampler2DArray diffuseMaps;
+#endif
+#if HAS_SPECULAR_MAP
+layout (binding = 1) uniform sampler2DArray specularMaps;
+#endif
+#if HAS_NORMAL_MAP
+layout (binding = 2) uniform sampler2DArray normalMaps;
+#endif
+
+// surface properties, fetched once per fragment and shared by every light
+vec3 albedo;
+vec3 specularColor;
+float shininess;
 
 // function prototypes
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcSpecular(vec3 lightDir, vec3 normal, vec3 viewDir);
+#if USE_SHADOWS
+float CalcShadow(vec3 fragPos, vec3 normal, vec3 lightDir);
+#endif
+#if USE_POINT_SHADOWS
+float CalcPointShadow(PointLight light, vec3 fragPos, vec3 normal);
+#endif
 
 void main()
 {    
     // properties
+    Material material = materials[MaterialIndex];
+    shininess = material.shininess;
+#if HAS_NORMAL_MAP
+    vec3 norm = normalize(TBN * (texture(normalMaps, vec3(TexCoords, material.normalLayer)).rgb * 2.0 - 1.0));
+#else
     vec3 norm = normalize(Normal);
+#endif
     vec3 viewDir = normalize(viewPos - FragPos);
+#if HAS_DIFFUSE_MAP
+    albedo = texture(diffuseMaps, vec3(TexCoords, material.diffuseLayer)).rgb;
+#else
+    albedo = vec3(1.0);
+#endif
+#if HAS_SPECULAR_MAP
+    specularColor = texture(specularMaps, vec3(TexCoords, material.specularLayer)).rgb;
+#else
+    specularColor = vec3(0.0);
+#endif
     
     // == =====================================================
     // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
     // For each phase, a calculate function is defined that calculates the corresponding color
     // per lamp. In the main() function we take all the calculated colors and sum them up for
-    // this fragment's final color.
+    // this fragment's final color. Phases the permutation doesn't use are compiled out.
     // == =====================================================
+    vec3 result = vec3(0.0);
     // phase 1: directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+#if USE_DIR_LIGHT
+#if USE_SHADOWS
+    float shadow = CalcShadow(FragPos, normalize(Normal), normalize(-dirLight.direction));
+#else
+    float shadow = 1.0;
+#endif
+    result += CalcDirLight(dirLight, norm, viewDir, shadow);
+#endif
     // phase 2: point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+#if USE_CLUSTERED_LIGHTS
+    // only the lights whose bounds touch this fragment's cluster
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+    uint slice = uint(max(log(viewDepth) * clusterParams.z - clusterParams.w, 0.0));
+    uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy / clusterParams.xy), min(slice, clusterGrid.z - 1u));
+    cluster.xy = min(cluster.xy, clusterGrid.xy - 1u);
+    uvec2 range = clusterRanges[cluster.x + clusterGrid.x * (cluster.y + clusterGrid.y * cluster.z)];
+    for(uint i = 0u; i < range.y; i++)
+        result += CalcPointLight(pointLights[clusterLightIndices[range.x + i]], norm, FragPos, viewDir);
+#else
+    for(uint i = 0u; i < pointLightCount; i++)
         result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
+#endif
     // phase 3: spot light
+#if USE_SPOT_LIGHT
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);    
+#endif
     
     FragColor = vec4(result, 1.0);
 }
 
-// calculates the color when using a directional light.
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+// specular term, only evaluated when the material has a specular map
+vec3 CalcSpecular(vec3 lightDir, vec3 normal, vec3 viewDir)
+{
+#if HAS_SPECULAR_MAP
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    return spec * specularColor;
+#else
+    return vec3(0.0);
+#endif
+}
+
+// calculates the color when using a directional light, shadow only darkens the direct part.
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
-    return (ambient + diffuse + specular);
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * CalcSpecular(lightDir, normal, viewDir);
+    return (ambient + (diffuse + specular) * shadow);
+}
+
+#if USE_SHADOWS
+// fraction of the directional light reaching fragPos, 1 beyond the last cascade
+float CalcShadow(vec3 fragPos, vec3 normal, vec3 lightDir)
+{
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = 0;
+    while (cascade < SHADOW_CASCADES && viewDepth > cascadeSplits[cascade])
+        cascade++;
+    if (cascade == SHADOW_CASCADES)
+        return 1.0;
+    // push the receiver off its surface by a few texels of its cascade, more at grazing angles
+    float slope = 1.0 - max(dot(normal, lightDir), 0.0);
+    vec3 offsetPos = fragPos + normal * (cascadeTexelSize[cascade] * shadowParams.x * slope);
+    vec4 lightPos = cascadeViewProjection[cascade] * vec4(offsetPos, 1.0);
+    vec3 coords = lightPos.xyz / lightPos.w * 0.5 + 0.5;
+    return texture(shadowCascades, vec4(coords.xy, float(cascade), coords.z - shadowParams.y));
 }
+#endif
+
+#if USE_POINT_SHADOWS
+// fraction of a point light reaching fragPos, 1 for lights without a cube
+float CalcPointShadow(PointLight light, vec3 fragPos, vec3 normal)
+{
+    if (light.shadowIndex < 0)
+        return 1.0;
+    // push the receiver off its surface by a texel, which spans 2 * distance / resolution
+    float distance = length(fragPos - light.position);
+    float texel = 2.0 * distance / float(textureSize(pointShadowCubes, 0).x);
+    vec3 toFrag = fragPos + normal * (1.5 * texel) - light.position;
+    return texture(pointShadowCubes, vec4(toFrag, float(light.shadowIndex)), length(toFrag) / light.radius);
+}
+#endif
 
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -104,19 +296,25 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    // fade out towards the radius the light was clustered with, so the cut-off isn't visible
+    float falloff = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= falloff * falloff;
+    // occlusion from the light's cube, the offset uses the geometric normal
+#if USE_POINT_SHADOWS
+    float shadow = CalcPointShadow(light, fragPos, normalize(Normal));
+#else
+    float shadow = 1.0;
+#endif
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * CalcSpecular(lightDir, normal, viewDir);
     ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
+    diffuse *= attenuation * shadow;
+    specular *= attenuation * shadow;
     return (ambient + diffuse + specular);
 }
 
@@ -126,9 +324,6 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
@@ -137,9 +332,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * albedo;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * CalcSpecular(lightDir, normal, viewDir);
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
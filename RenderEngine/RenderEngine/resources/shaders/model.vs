@@ -1,21 +1,132 @@
 #version 430 core
+#ifndef HAS_NORMAL_MAP
+#define HAS_NORMAL_MAP 0
+#endif
+// vertices in the CompactVertex format of the GeometryPool
+#ifndef COMPACT_VERTICES
+#define COMPACT_VERTICES 0
+#endif
+
+#if COMPACT_VERTICES
+layout (location = 0) in vec4 aPos;         // unorm16 inside the mesh bounds, w the bitangent sign
+layout (location = 1) in vec2 aNormal;      // octahedral
+layout (location = 2) in vec2 aTexCoords;   // half floats
+#if HAS_NORMAL_MAP
+layout (location = 3) in vec2 aTangent;     // octahedral
+#endif
+#else
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#if HAS_NORMAL_MAP
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+#endif
+#endif
+// base instance of the draw, fed by the GeometryPool
+layout (location = 5) in uint aDrawID;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out uint MaterialIndex;
+#if HAS_NORMAL_MAP
+out mat3 TBN;
+#endif
+
+struct Instance {
+    mat4 model;
+    mat3 normalMatrix;          // transpose(inverse(mat3(model))), built on the CPU
+};
+
+// transforms of the instances of every draw
+layout (std430, binding = 3) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+struct DrawRecord {
+    uint firstInstance;
+    uint material;              // index into the Materials block
+    uint mesh;                  // index into the Meshes block
+    uint padding;
+};
+
+layout (std430, binding = 4) readonly buffer Draws
+{
+    DrawRecord draws[];
+};
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#if COMPACT_VERTICES
+// model space position = aPos * scale + bias, undoes the quantization of compact vertices
+struct MeshBounds {
+    vec4 scale;
+    vec4 bias;
+};
+
+layout (std430, binding = 6) readonly buffer Meshes
+{
+    MeshBounds meshes[];
+};
+#endif
+
+layout (std140, binding = 0) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+};
+
+#if COMPACT_VERTICES
+// inverse of the octahedral folding done by the GeometryPool
+vec3 DecodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+#endif
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    DrawRecord draw = draws[aDrawID];
+    uint instance = draw.firstInstance + uint(gl_InstanceID);
+    mat4 model = instances[instance].model;
+#if COMPACT_VERTICES
+    vec3 normal = DecodeOctahedral(aNormal);
+#if HAS_NORMAL_MAP
+    vec3 tangent = DecodeOctahedral(aTangent);
+    vec3 bitangent = cross(normal, tangent) * (aPos.w > 0.5 ? 1.0 : -1.0);
+#endif
+#else
+    vec3 normal = aNormal;
+#if HAS_NORMAL_MAP
+    vec3 tangent = aTangent;
+    vec3 bitangent = aBitangent;
+#endif
+#endif
+#if COMPACT_VERTICES
+    vec3 position = aPos.xyz * meshes[draw.mesh].scale.xyz + meshes[draw.mesh].bias.xyz;
+#else
+    vec3 position = aPos;
+#endif
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = instances[instance].normalMatrix * normal;
     TexCoords = aTexCoords;
+    MaterialIndex = draw.material;
+#if HAS_NORMAL_MAP
+    // tangent frame in world space for the normal map lookup. Under non-uniform scale the model
+    // matrix skews the tangent off the normal, so it is made orthogonal to the normal again and
+    // the bitangent rebuilt with the handedness of the vertex, flipped by mirroring transforms
+    vec3 N = normalize(Normal);
+    vec3 T = mat3(model) * tangent;
+    T = normalize(T - dot(T, N) * N);
+    float handedness = dot(cross(normal, tangent), bitangent) < 0.0 ? -1.0 : 1.0;
+    if (determinant(mat3(model)) < 0.0)
+        handedness = -handedness;
+    TBN = mat3(T, cross(N, T) * handedness, N);
+#endif
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
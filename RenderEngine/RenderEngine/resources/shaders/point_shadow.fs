@@ -0,0 +1,10 @@
+#version 430 core
+// distance to the light over its radius, the value the lit passes compare against
+in vec3 WorldPos;
+
+uniform vec4 lightPositionRadius;
+
+void main()
+{
+    gl_FragDepth = length(WorldPos - lightPositionRadius.xyz) / lightPositionRadius.w;
+}
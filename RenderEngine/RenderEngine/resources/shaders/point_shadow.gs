@@ -0,0 +1,37 @@
+#version 430 core
+// one invocation per cube face, each triangle is emitted only to the faces it can cover
+layout (triangles, invocations = 6) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+uniform mat4 faceViewProjection[6];
+uniform int faceMask;           // faces the caster's bounds reach, see PointShadowMap::faceMask
+
+out vec3 WorldPos;
+
+void main()
+{
+    int face = gl_InvocationID;
+    if ((faceMask & (1 << face)) == 0)
+        return;
+
+    vec4 clip[3];
+    for (int i = 0; i < 3; i++)
+        clip[i] = faceViewProjection[face] * gl_in[i].gl_Position;
+    // the whole triangle is outside one side of this face's frustum
+    for (int axis = 0; axis < 2; axis++)
+    {
+        if (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w)
+            return;
+        if (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w)
+            return;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        gl_Layer = face;           // the light's cube is attached as a view of its six faces
+        WorldPos = gl_in[i].gl_Position.xyz;
+        gl_Position = clip[i];
+        EmitVertex();
+    }
+    EndPrimitive();
+}
@@ -0,0 +1,6 @@
+#version 430 core
+// no color attachment, only the depth of the casters is written
+
+void main()
+{
+}
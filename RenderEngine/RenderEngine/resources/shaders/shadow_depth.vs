@@ -0,0 +1,59 @@
+#version 430 core
+// depth only pass of the shadow casters, fed from the position only stream of each mesh
+// positions in the CompactVertex format of the GeometryPool
+#ifndef COMPACT_VERTICES
+#define COMPACT_VERTICES 0
+#endif
+layout (location = 0) in vec3 aPos;
+// base instance of the draw, fed by the GeometryPool
+layout (location = 5) in uint aDrawID;
+
+struct Instance {
+    mat4 model;
+    mat3 normalMatrix;          // transpose(inverse(mat3(model))), built on the CPU
+};
+
+// transforms of the instances of every draw
+layout (std430, binding = 3) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+struct DrawRecord {
+    uint firstInstance;
+    uint material;              // index into the Materials block
+    uint mesh;                  // index into the Meshes block
+    uint padding;
+};
+
+layout (std430, binding = 4) readonly buffer Draws
+{
+    DrawRecord draws[];
+};
+
+#if COMPACT_VERTICES
+// model space position = aPos * scale + bias, undoes the quantization of compact vertices
+struct MeshBounds {
+    vec4 scale;
+    vec4 bias;
+};
+
+layout (std430, binding = 6) readonly buffer Meshes
+{
+    MeshBounds meshes[];
+};
+#endif
+
+// the cascade being rendered, see CascadedShadowMap
+uniform mat4 lightViewProjection;
+
+void main()
+{
+    DrawRecord draw = draws[aDrawID];
+#if COMPACT_VERTICES
+    vec3 position = aPos * meshes[draw.mesh].scale.xyz + meshes[draw.mesh].bias.xyz;
+#else
+    vec3 position = aPos;
+#endif
+    gl_Position = lightViewProjection * instances[draw.firstInstance + uint(gl_InstanceID)].model * vec4(position, 1.0);
+}
@@ -0,0 +1,114 @@
+#include "bufferlayout.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace graphics {
+
+	BufferLayout::BufferLayout(unsigned int divisor)
+		:m_Stride(0), m_FixedStride(false), m_Divisor(divisor)
+	{
+	}
+
+	BufferLayout& BufferLayout::add(const std::string &name, unsigned int location, int components, AttributeType type, bool normalized)
+	{
+		unsigned int offset = 0;
+		for (unsigned int i = 0; i < m_Attributes.size(); i++)
+		{
+			const VertexAttribute &attribute = m_Attributes[i];
+			offset = std::max(offset, attribute.offset + getSize(attribute.type, attribute.components));
+		}
+		return add(name, location, components, type, normalized, (offset + 3) & ~3u);
+	}
+
+	BufferLayout& BufferLayout::add(const std::string &name, unsigned int location, int components, AttributeType type, bool normalized, unsigned int offset)
+	{
+		if (type == INT_2_10_10_10_REV_ATTRIBUTE && components != 4)
+			std::cout << "ERROR::BUFFERLAYOUT::PACKED_ATTRIBUTE_NEEDS_4_COMPONENTS " << name << std::endl;
+
+		VertexAttribute attribute;
+		attribute.name = name;
+		attribute.location = location;
+		attribute.components = components;
+		attribute.type = type;
+		attribute.normalized = normalized;
+		attribute.offset = offset;
+		m_Attributes.push_back(attribute);
+
+		if (!m_FixedStride)
+			m_Stride = std::max(m_Stride, (offset + getSize(type, components) + 3) & ~3u);
+		return *this;
+	}
+
+	BufferLayout& BufferLayout::setStride(unsigned int stride)
+	{
+		m_Stride = stride;
+		m_FixedStride = true;
+		return *this;
+	}
+
+	bool BufferLayout::setOffset(unsigned int location, unsigned int offset)
+	{
+		for (unsigned int i = 0; i < m_Attributes.size(); i++)
+		{
+			if (m_Attributes[i].location != location)
+				continue;
+			m_Attributes[i].offset = offset;
+			if (!m_FixedStride)
+				m_Stride = std::max(m_Stride, (offset + getSize(m_Attributes[i].type, m_Attributes[i].components) + 3) & ~3u);
+			return true;
+		}
+		return false;
+	}
+
+	unsigned int BufferLayout::getComponentCount() const
+	{
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < m_Attributes.size(); i++)
+			count += m_Attributes[i].components;
+		return count;
+	}
+
+	void BufferLayout::apply(unsigned int binding) const
+	{
+		for (unsigned int i = 0; i < m_Attributes.size(); i++)
+		{
+			const VertexAttribute &attribute = m_Attributes[i];
+			glEnableVertexAttribArray(attribute.location);
+			if (attribute.type == UINT_ATTRIBUTE)
+				glVertexAttribIFormat(attribute.location, attribute.components, GL_UNSIGNED_INT, attribute.offset);
+			else
+				glVertexAttribFormat(attribute.location, attribute.components, getGLType(attribute.type),
+					attribute.normalized ? GL_TRUE : GL_FALSE, attribute.offset);
+			glVertexAttribBinding(attribute.location, binding);
+		}
+		glVertexBindingDivisor(binding, m_Divisor);
+	}
+
+	GLenum BufferLayout::getGLType(AttributeType type)
+	{
+		switch (type)
+		{
+		case HALF_ATTRIBUTE: return GL_HALF_FLOAT;
+		case SHORT_ATTRIBUTE: return GL_SHORT;
+		case USHORT_ATTRIBUTE: return GL_UNSIGNED_SHORT;
+		case INT_2_10_10_10_REV_ATTRIBUTE: return GL_INT_2_10_10_10_REV;
+		case UBYTE_ATTRIBUTE: return GL_UNSIGNED_BYTE;
+		case UINT_ATTRIBUTE: return GL_UNSIGNED_INT;
+		default: return GL_FLOAT;
+		}
+	}
+
+	unsigned int BufferLayout::getSize(AttributeType type, int components)
+	{
+		switch (type)
+		{
+		case HALF_ATTRIBUTE:
+		case SHORT_ATTRIBUTE:
+		case USHORT_ATTRIBUTE: return 2 * components;
+		case INT_2_10_10_10_REV_ATTRIBUTE: return 4;
+		case UBYTE_ATTRIBUTE: return components;
+		default: return 4 * components;
+		}
+	}
+}
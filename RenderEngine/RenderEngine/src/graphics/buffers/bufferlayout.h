@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+namespace graphics {
+
+	// storage of one attribute component
+	enum AttributeType {
+		FLOAT_ATTRIBUTE,
+		HALF_ATTRIBUTE,
+		SHORT_ATTRIBUTE,				// snorm16 when normalized
+		USHORT_ATTRIBUTE,				// unorm16 when normalized
+		INT_2_10_10_10_REV_ATTRIBUTE,	// 4 components packed into 32 bits, x in the low bits
+		UBYTE_ATTRIBUTE,
+		UINT_ATTRIBUTE					// read as an integer, uint in the shader
+	};
+
+	struct VertexAttribute {
+		std::string name;
+		unsigned int location;
+		int components;
+		AttributeType type;
+		bool normalized;
+		// bytes from the start of the vertex
+		unsigned int offset;
+	};
+
+	// How the vertices of one buffer are laid out: any number of attributes of mixed formats
+	// interleaved with a common stride, plus the instance divisor of the whole buffer (0 for
+	// per-vertex data). Attributes added without an offset are packed after the previous ones,
+	// each starting 4 byte aligned, and grow the stride unless it was set explicitly.
+	//
+	//   BufferLayout layout;
+	//   layout.add("aPos", 0, 3).add("aNormal", 1, 4, INT_2_10_10_10_REV_ATTRIBUTE, true);
+	//
+	// The layout is applied with the separate attribute format of GL 4.3, so the buffer behind
+	// a binding point can be swapped or moved without specifying the attributes again.
+	class BufferLayout
+	{
+	private:
+		std::vector<VertexAttribute> m_Attributes;
+		unsigned int m_Stride;
+		bool m_FixedStride;
+		unsigned int m_Divisor;
+
+	public:
+		explicit BufferLayout(unsigned int divisor = 0);
+
+		BufferLayout& add(const std::string &name, unsigned int location, int components, AttributeType type = FLOAT_ATTRIBUTE, bool normalized = false);
+		BufferLayout& add(const std::string &name, unsigned int location, int components, AttributeType type, bool normalized, unsigned int offset);
+		// stride for vertices with padding or data no attribute reads
+		BufferLayout& setStride(unsigned int stride);
+		// moves an attribute inside the vertex, returns false if no attribute uses location
+		bool setOffset(unsigned int location, unsigned int offset);
+
+		// enables and formats every attribute of the bound vertex array and routes it to binding
+		void apply(unsigned int binding) const;
+
+		inline const std::vector<VertexAttribute> &getAttributes() const { return m_Attributes; }
+		inline unsigned int getStride() const { return m_Stride; }
+		inline unsigned int getDivisor() const { return m_Divisor; }
+		// components of all attributes of a vertex
+		unsigned int getComponentCount() const;
+
+		static GLenum getGLType(AttributeType type);
+		// bytes of an attribute with the given components
+		static unsigned int getSize(AttributeType type, int components);
+	};
+}
@@ -0,0 +1,268 @@
+#include "geometrypool.h"
+#include "../glstate.h"
+#include "../mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace graphics {
+
+	// storage of size bytes, filled through the copy target so no vertex array picks it up
+	static unsigned int createBuffer(unsigned int size)
+	{
+		unsigned int buffer;
+		glGenBuffers(1, &buffer);
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+		return buffer;
+	}
+
+	static void copyBuffer(unsigned int source, unsigned int destination, unsigned int size)
+	{
+		if (size == 0)
+			return;
+		GLState::bindBuffer(GL_COPY_READ_BUFFER, source);
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, destination);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+	}
+
+	// octahedral encoding, the unit sphere folded onto a square of two snorm16
+	static unsigned int packOctahedral(const glm::vec3 &v)
+	{
+		float length = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+		if (length == 0.0f)
+			return glm::packSnorm2x16(glm::vec2(0.0f));
+		glm::vec3 n = v / length;
+		glm::vec2 folded(n.x, n.y);
+		if (n.z < 0.0f)
+			folded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		return glm::packSnorm2x16(folded);
+	}
+
+	static unsigned short quantize(float value, float minimum, float extent)
+	{
+		if (extent <= 0.0f)
+			return 0;
+		float normalized = std::min(std::max((value - minimum) / extent, 0.0f), 1.0f);
+		return (unsigned short)(normalized * 65535.0f + 0.5f);
+	}
+
+	GeometryPool::GeometryPool(VertexFormat format, unsigned int vertexCapacity, unsigned int indexCapacity)
+		:m_Format(format), m_DrawIDLayout(DRAW_ID_DIVISOR), m_VertexCapacity(vertexCapacity), m_IndexCapacity(indexCapacity),
+		m_DrawIDCapacity(0), m_MeshCapacity(256), m_VertexCount(0), m_IndexCount(0), m_IndexBytes(0)
+	{
+		if (m_Format == COMPACT_VERTICES)
+		{
+			// the shader reads aPos as a vec4 for the sign, the depth passes only the position
+			m_VertexLayout.add("aPos", 0, 4, USHORT_ATTRIBUTE, true, offsetof(CompactVertex, position))
+				.add("aNormal", 1, 2, SHORT_ATTRIBUTE, true, offsetof(CompactVertex, normal))
+				.add("aTexCoords", 2, 2, HALF_ATTRIBUTE, false, offsetof(CompactVertex, texCoords))
+				.add("aTangent", 3, 2, SHORT_ATTRIBUTE, true, offsetof(CompactVertex, tangent))
+				.setStride(sizeof(CompactVertex));
+			m_PositionLayout.add("aPos", 0, 3, USHORT_ATTRIBUTE, true).setStride(4 * sizeof(unsigned short));
+		}
+		else
+		{
+			m_VertexLayout.add("aPos", 0, 3, FLOAT_ATTRIBUTE, false, offsetof(VertexData, Position))
+				.add("aNormal", 1, 3, FLOAT_ATTRIBUTE, false, offsetof(VertexData, Normal))
+				.add("aTexCoords", 2, 2, FLOAT_ATTRIBUTE, false, offsetof(VertexData, TexCoords))
+				.add("aTangent", 3, 3, FLOAT_ATTRIBUTE, false, offsetof(VertexData, Tangent))
+				.add("aBitangent", 4, 3, FLOAT_ATTRIBUTE, false, offsetof(VertexData, Bitangent))
+				.setStride(sizeof(VertexData));
+			m_PositionLayout.add("aPos", 0, 3);
+		}
+		m_DrawIDLayout.add("aDrawID", DRAW_ID_ATTRIBUTE, 1, UINT_ATTRIBUTE);
+
+		m_VertexBuffer = createBuffer(m_VertexCapacity * getVertexSize());
+		m_PositionBuffer = createBuffer(m_VertexCapacity * getPositionSize());
+		m_IndexBuffer = createBuffer(m_IndexCapacity);
+		m_MeshBuffer = createBuffer(m_MeshCapacity * sizeof(MeshBounds));
+		glGenBuffers(1, &m_DrawIDBuffer);
+		growDrawIDs(1024);
+
+		// the formats are fixed, growing only swaps the buffers behind the binding points
+		glGenVertexArrays(1, &m_VertexArray);
+		GLState::bindVertexArray(m_VertexArray);
+		m_VertexLayout.apply(VERTEX_BINDING);
+		m_DrawIDLayout.apply(DRAW_ID_BINDING);
+
+		glGenVertexArrays(1, &m_DepthVertexArray);
+		GLState::bindVertexArray(m_DepthVertexArray);
+		m_PositionLayout.apply(VERTEX_BINDING);
+		m_DrawIDLayout.apply(DRAW_ID_BINDING);
+		attachBuffers();
+	}
+
+	GeometryPool::~GeometryPool()
+	{
+		GLState::deleteVertexArray(m_VertexArray);
+		GLState::deleteVertexArray(m_DepthVertexArray);
+		GLState::deleteBuffer(m_VertexBuffer);
+		GLState::deleteBuffer(m_PositionBuffer);
+		GLState::deleteBuffer(m_IndexBuffer);
+		GLState::deleteBuffer(m_DrawIDBuffer);
+		GLState::deleteBuffer(m_MeshBuffer);
+	}
+
+	unsigned int GeometryPool::allocate(const VertexData* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount,
+		unsigned int &baseVertex, unsigned int &firstIndex, GLenum &indexType)
+	{
+		// the indices are relative to the mesh's first vertex, its own count decides their size
+		indexType = IndexBuffer::getIndexType(vertexCount);
+		unsigned int indexSize = IndexBuffer::getIndexSize(indexType);
+		// draws address the indices in units of their size
+		unsigned int indexStart = (m_IndexBytes + indexSize - 1) / indexSize * indexSize;
+		unsigned int indexEnd = indexStart + indexCount * indexSize;
+
+		if (m_VertexCount + vertexCount > m_VertexCapacity || indexEnd > m_IndexCapacity)
+			grow(std::max(m_VertexCapacity * 2, m_VertexCount + vertexCount), std::max(m_IndexCapacity * 2, indexEnd));
+
+		baseVertex = m_VertexCount;
+		firstIndex = indexStart / indexSize;
+
+		MeshBounds bounds;
+		bounds.scale = glm::vec4(1.0f);
+		bounds.bias = glm::vec4(0.0f);
+		unsigned int vertexSize = getVertexSize(), positionSize = getPositionSize();
+		// both streams of the mesh, in the pool's format
+		std::vector<unsigned char> packed(vertexCount * vertexSize), positions(vertexCount * positionSize);
+		if (m_Format == COMPACT_VERTICES && vertexCount > 0)
+		{
+			glm::vec3 minimum(vertices[0].Position), maximum(vertices[0].Position);
+			for (unsigned int i = 1; i < vertexCount; i++)
+			{
+				minimum = glm::min(minimum, vertices[i].Position);
+				maximum = glm::max(maximum, vertices[i].Position);
+			}
+			glm::vec3 extent = maximum - minimum;
+			bounds.scale = glm::vec4(extent, 1.0f);
+			bounds.bias = glm::vec4(minimum, 0.0f);
+
+			CompactVertex* compact = (CompactVertex*)&packed[0];
+			for (unsigned int i = 0; i < vertexCount; i++)
+			{
+				const VertexData &vertex = vertices[i];
+				for (int c = 0; c < 3; c++)
+					compact[i].position[c] = quantize(vertex.Position[c], minimum[c], extent[c]);
+				// which way the bitangent points relative to cross(normal, tangent)
+				bool flipped = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f;
+				compact[i].position[3] = flipped ? 0 : 65535;
+				compact[i].normal = packOctahedral(vertex.Normal);
+				compact[i].tangent = packOctahedral(vertex.Tangent);
+				compact[i].texCoords = glm::packHalf2x16(vertex.TexCoords);
+				std::memcpy(&positions[i * positionSize], compact[i].position, positionSize);
+			}
+		}
+		else if (vertexCount > 0)
+		{
+			std::memcpy(&packed[0], vertices, vertexCount * vertexSize);
+			for (unsigned int i = 0; i < vertexCount; i++)
+				std::memcpy(&positions[i * positionSize], &vertices[i].Position, positionSize);
+		}
+
+		if (vertexCount > 0)
+		{
+			GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_VertexBuffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * vertexSize, vertexCount * vertexSize, &packed[0]);
+			GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_PositionBuffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * positionSize, vertexCount * positionSize, &positions[0]);
+		}
+		if (indexCount > 0)
+		{
+			std::vector<unsigned char> narrowed(indexCount * indexSize);
+			IndexBuffer::pack(indices, indexCount, indexType, &narrowed[0]);
+			GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_IndexBuffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, indexStart, indexCount * indexSize, &narrowed[0]);
+		}
+
+		m_VertexCount += vertexCount;
+		m_IndexCount += indexCount;
+		m_IndexBytes = indexEnd;
+
+		// the records are few, the whole block is uploaded again when it grows
+		unsigned int mesh = (unsigned int)m_Meshes.size();
+		m_Meshes.push_back(bounds);
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_MeshBuffer);
+		if (m_Meshes.size() > m_MeshCapacity)
+		{
+			m_MeshCapacity *= 2;
+			glBufferData(GL_COPY_WRITE_BUFFER, m_MeshCapacity * sizeof(MeshBounds), NULL, GL_STATIC_DRAW);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, 0, m_Meshes.size() * sizeof(MeshBounds), &m_Meshes[0]);
+		}
+		else
+			glBufferSubData(GL_COPY_WRITE_BUFFER, mesh * sizeof(MeshBounds), sizeof(MeshBounds), &bounds);
+		return mesh;
+	}
+
+	void GeometryPool::bindMeshes() const
+	{
+		GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_STORAGE_BINDING, m_MeshBuffer);
+	}
+
+	void GeometryPool::printStats() const
+	{
+		unsigned int vertexBytes = m_VertexCount * (getVertexSize() + getPositionSize());
+		unsigned int fullBytes = m_VertexCount * (unsigned int)(sizeof(VertexData) + sizeof(glm::vec3));
+		std::cout << "Geometry pool: " << m_VertexCount << " vertices in " << vertexBytes / 1024 << " KB ("
+			<< getVertexSize() << " + " << getPositionSize() << " bytes each";
+		if (m_Format == COMPACT_VERTICES && vertexBytes > 0)
+			std::cout << ", " << (float)fullBytes / vertexBytes << "x smaller than full vertices";
+		unsigned int wideBytes = m_IndexCount * (unsigned int)sizeof(unsigned int);
+		std::cout << "), " << m_IndexCount << " indices in " << m_IndexBytes / 1024 << " KB ("
+			<< (wideBytes > m_IndexBytes ? wideBytes - m_IndexBytes : 0) / 1024 << " KB saved by narrow indices)" << std::endl;
+	}
+
+	void GeometryPool::grow(unsigned int vertexCapacity, unsigned int indexCapacity)
+	{
+		unsigned int vertexBuffer = createBuffer(vertexCapacity * getVertexSize());
+		unsigned int positionBuffer = createBuffer(vertexCapacity * getPositionSize());
+		unsigned int indexBuffer = createBuffer(indexCapacity);
+		copyBuffer(m_VertexBuffer, vertexBuffer, m_VertexCount * getVertexSize());
+		copyBuffer(m_PositionBuffer, positionBuffer, m_VertexCount * getPositionSize());
+		copyBuffer(m_IndexBuffer, indexBuffer, m_IndexBytes);
+
+		GLState::deleteBuffer(m_VertexBuffer);
+		GLState::deleteBuffer(m_PositionBuffer);
+		GLState::deleteBuffer(m_IndexBuffer);
+		m_VertexBuffer = vertexBuffer;
+		m_PositionBuffer = positionBuffer;
+		m_IndexBuffer = indexBuffer;
+		m_VertexCapacity = vertexCapacity;
+		m_IndexCapacity = indexCapacity;
+		attachBuffers();
+	}
+
+	void GeometryPool::growDrawIDs(unsigned int count)
+	{
+		// the buffer name stays, the vertex arrays keep pointing at it
+		unsigned int capacity = std::max(m_DrawIDCapacity, 1024u);
+		while (capacity < count)
+			capacity *= 2;
+		std::vector<unsigned int> ids(capacity);
+		for (unsigned int i = 0; i < capacity; i++)
+			ids[i] = i;
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_DrawIDBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(unsigned int), &ids[0], GL_STATIC_DRAW);
+		m_DrawIDCapacity = capacity;
+	}
+
+	void GeometryPool::attachBuffers()
+	{
+		GLState::bindVertexArray(m_VertexArray);
+		glBindVertexBuffer(VERTEX_BINDING, m_VertexBuffer, 0, m_VertexLayout.getStride());
+		glBindVertexBuffer(DRAW_ID_BINDING, m_DrawIDBuffer, 0, m_DrawIDLayout.getStride());
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer);
+
+		GLState::bindVertexArray(m_DepthVertexArray);
+		glBindVertexBuffer(VERTEX_BINDING, m_PositionBuffer, 0, m_PositionLayout.getStride());
+		glBindVertexBuffer(DRAW_ID_BINDING, m_DrawIDBuffer, 0, m_DrawIDLayout.getStride());
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer);
+
+#if GLSTATE_UNBIND
+		GLState::bindVertexArray(0);
+#endif
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <iostream>
+#include <vector>
+
+#include "bufferlayout.h"
+#include "indexbuffer.h"
+#include "../uniformblocks.h"
+
+namespace graphics {
+
+	struct VertexData;
+
+	// how a GeometryPool stores its vertices, the shaders follow through COMPACT_VERTICES
+	enum VertexFormat {
+		FULL_VERTICES,		// VertexData as is, 56 bytes
+		COMPACT_VERTICES	// CompactVertex, 20 bytes
+	};
+
+	// Vertex of COMPACT_VERTICES. Positions are unorm16 inside the mesh's bounding box, the
+	// MeshBounds of the mesh scale them back; w is the bitangent sign, 0 for -1. Normal and
+	// tangent are octahedral snorm16 pairs and the bitangent is rebuilt in the shader as
+	// cross(normal, tangent) * sign. Texture coordinates are two halfs
+	struct CompactVertex {
+		unsigned short position[4];
+		unsigned int normal;
+		unsigned int tangent;
+		unsigned int texCoords;
+	};
+
+	// Shared vertex and index storage of static meshes in the VertexData format. Every mesh gets
+	// a range of each; its indices stay relative to its first vertex and are drawn with a base
+	// vertex, so all meshes of a pool share one vertex array and any set of them fits into a
+	// single glMultiDrawElementsIndirect. Ranges are never freed, the buffers double when full.
+	//
+	// Since the indices are relative, each mesh stores them in the narrowest type its own vertex
+	// count allows, 8, 16 or 32 bit, aligned to their size in the shared index buffer. A multi
+	// draw reads one type, so only meshes with the same index type share one.
+	//
+	// Every mesh also gets a MeshBounds record in the Meshes block, the shaders rebuild positions
+	// with it. For compact vertices it holds the mesh's quantization box, otherwise the identity.
+	//
+	// Both vertex arrays also feed aDrawID (DRAW_ID_ATTRIBUTE) from a buffer holding 0, 1, 2, ...
+	// with a divisor no draw reaches. Instanced attributes start at the draw's base instance and
+	// never advance, so aDrawID is the base instance of the draw: gl_DrawID for the commands of
+	// a multi draw, which GL 4.3 doesn't have. It indexes the DrawRecords of the Draws block.
+	class GeometryPool
+	{
+	public:
+		static const unsigned int DRAW_ID_ATTRIBUTE = 5;
+		static const unsigned int DRAW_ID_DIVISOR = 1u << 30;
+
+	private:
+		// vertex buffer binding points of the vertex arrays
+		enum { VERTEX_BINDING = 0, DRAW_ID_BINDING = 1 };
+
+		unsigned int m_VertexBuffer;
+		// tightly packed positions sharing the index buffer, casters fetch 12 (compact: 8) bytes per vertex instead of 56 (20)
+		unsigned int m_PositionBuffer;
+		unsigned int m_IndexBuffer;
+		unsigned int m_DrawIDBuffer;
+		unsigned int m_MeshBuffer;
+		unsigned int m_VertexArray, m_DepthVertexArray;
+		VertexFormat m_Format;
+		// formats of the vertex, position and draw id streams
+		BufferLayout m_VertexLayout, m_PositionLayout, m_DrawIDLayout;
+
+		// the index capacity and use are in bytes, the meshes mix index sizes
+		unsigned int m_VertexCapacity, m_IndexCapacity, m_DrawIDCapacity, m_MeshCapacity;
+		unsigned int m_VertexCount, m_IndexCount, m_IndexBytes;
+		std::vector<MeshBounds> m_Meshes;
+
+	public:
+		// initial room for vertexCapacity vertices and indexCapacity bytes of indices
+		GeometryPool(VertexFormat format = FULL_VERTICES, unsigned int vertexCapacity = 1 << 16, unsigned int indexCapacity = 1 << 20);
+		~GeometryPool();
+
+		// copies a mesh in, baseVertex and firstIndex receive where it went and indexType what
+		// the indices were narrowed to; firstIndex counts indices of that type. Returns the mesh's
+		// index in the Meshes block
+		unsigned int allocate(const VertexData* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount,
+			unsigned int &baseVertex, unsigned int &firstIndex, GLenum &indexType);
+
+		// binds the Meshes block, part of binding the geometry
+		void bindMeshes() const;
+
+		// aDrawID has to reach count draws
+		inline void reserveDraws(unsigned int count) { if (count > m_DrawIDCapacity) growDrawIDs(count); }
+
+		// every attribute, and positions only for depth passes. The index buffer is part of both
+		inline unsigned int getVertexArray() const { return m_VertexArray; }
+		inline unsigned int getDepthVertexArray() const { return m_DepthVertexArray; }
+		inline unsigned int getIndexBuffer() const { return m_IndexBuffer; }
+		inline unsigned int getVertexCount() const { return m_VertexCount; }
+		inline unsigned int getIndexCount() const { return m_IndexCount; }
+		inline unsigned int getIndexBytes() const { return m_IndexBytes; }
+		inline VertexFormat getFormat() const { return m_Format; }
+		// bytes per vertex of the full and the position only stream
+		inline unsigned int getVertexSize() const { return m_VertexLayout.getStride(); }
+		inline unsigned int getPositionSize() const { return m_PositionLayout.getStride(); }
+
+		void printStats() const;
+
+	private:
+		void grow(unsigned int vertexCapacity, unsigned int indexCapacity);
+		void growDrawIDs(unsigned int count);
+		// points both vertex arrays at the current buffers
+		void attachBuffers();
+	};
+}
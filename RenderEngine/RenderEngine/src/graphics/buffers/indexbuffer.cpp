@@ -1,25 +1,77 @@
 #include "indexbuffer.h"
+#include "../glstate.h"
+
+#include <cstring>
 
 namespace graphics {
-	IndexBuffer::IndexBuffer(unsigned int * indices, unsigned int primitiveCount, unsigned int componentCount)
-		:m_PrimitiveCount(primitiveCount), m_ComponentCount(componentCount)
+	IndexBuffer::IndexBuffer(const unsigned int * indices, unsigned int primitiveCount, unsigned int componentCount, BufferUsage usage)
+		:IndexBuffer(indices, primitiveCount, componentCount, GL_UNSIGNED_INT, usage)
+	{
+	}
+
+	IndexBuffer::IndexBuffer(const unsigned short * indices, unsigned int primitiveCount, unsigned int componentCount, BufferUsage usage)
+		:IndexBuffer(indices, primitiveCount, componentCount, GL_UNSIGNED_SHORT, usage)
+	{
+	}
+
+	IndexBuffer::IndexBuffer(const unsigned char * indices, unsigned int primitiveCount, unsigned int componentCount, BufferUsage usage)
+		:IndexBuffer(indices, primitiveCount, componentCount, GL_UNSIGNED_BYTE, usage)
+	{
+	}
+
+	IndexBuffer::IndexBuffer(const void* indices, unsigned int primitiveCount, unsigned int componentCount, GLenum type, BufferUsage usage)
+		:MappableBuffer(indices, primitiveCount * componentCount * getIndexSize(type), usage),
+		m_PrimitiveCount(primitiveCount), m_ComponentCount(componentCount), m_Type(type)
 	{
-		glGenBuffers(1, &m_IndexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_PrimitiveCount* m_ComponentCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 
 	IndexBuffer::~IndexBuffer()
 	{
-		glDeleteBuffers(1, &m_IndexBufferID);
 	}
 	void IndexBuffer::bind() const
 	{
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBufferID);
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_BufferID);
 	}
 	void IndexBuffer::unbind() const
 	{
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+#if GLSTATE_UNBIND
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+#endif
+	}
+
+	GLenum IndexBuffer::getIndexType(unsigned int vertexCount)
+	{
+		if (vertexCount <= 0x100)
+			return GL_UNSIGNED_BYTE;
+		if (vertexCount <= 0x10000)
+			return GL_UNSIGNED_SHORT;
+		return GL_UNSIGNED_INT;
+	}
+
+	unsigned int IndexBuffer::getIndexSize(GLenum type)
+	{
+		if (type == GL_UNSIGNED_BYTE)
+			return 1;
+		if (type == GL_UNSIGNED_SHORT)
+			return 2;
+		return 4;
+	}
+
+	void IndexBuffer::pack(const unsigned int* indices, unsigned int count, GLenum type, void* destination)
+	{
+		if (type == GL_UNSIGNED_BYTE)
+		{
+			unsigned char* narrow = (unsigned char*)destination;
+			for (unsigned int i = 0; i < count; i++)
+				narrow[i] = (unsigned char)indices[i];
+		}
+		else if (type == GL_UNSIGNED_SHORT)
+		{
+			unsigned short* narrow = (unsigned short*)destination;
+			for (unsigned int i = 0; i < count; i++)
+				narrow[i] = (unsigned short)indices[i];
+		}
+		else
+			std::memcpy(destination, indices, count * sizeof(unsigned int));
 	}
-}
\ No newline at end of file
+}
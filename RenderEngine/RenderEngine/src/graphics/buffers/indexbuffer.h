@@ -3,23 +3,42 @@
 #include <glad/glad.h>
 #include <iostream>
 
+#include "mappablebuffer.h"
+
 namespace graphics {
-	class IndexBuffer
+	// 8, 16 or 32 bit indices, componentCount per primitive. Draws pass getType() and start at
+	// getOffset(), non-static buffers are updated through map and commit, see MappableBuffer
+	class IndexBuffer : public MappableBuffer
 	{
 	private:
-		unsigned int m_IndexBufferID;
 		unsigned int m_PrimitiveCount;
 		unsigned int m_ComponentCount;
+		GLenum m_Type;
 
 	public:
-		IndexBuffer(unsigned int * indices, unsigned int primitiveCount, unsigned int componentCount);
+		IndexBuffer(const unsigned int * indices, unsigned int primitiveCount, unsigned int componentCount, BufferUsage usage = STATIC_BUFFER);
+		IndexBuffer(const unsigned short * indices, unsigned int primitiveCount, unsigned int componentCount, BufferUsage usage = STATIC_BUFFER);
+		IndexBuffer(const unsigned char * indices, unsigned int primitiveCount, unsigned int componentCount, BufferUsage usage = STATIC_BUFFER);
 
 		~IndexBuffer();
 
 		void bind() const;
 		void unbind() const;
 
-		inline unsigned int getPrimitiveCount() { return m_PrimitiveCount; }
-		inline unsigned int getComponentCount() { return m_ComponentCount; }
+		inline unsigned int getPrimitiveCount() const { return m_PrimitiveCount; }
+		inline unsigned int getComponentCount() const { return m_ComponentCount; }
+		inline unsigned int getIndexCount() const { return m_PrimitiveCount * m_ComponentCount; }
+		// GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+		inline GLenum getType() const { return m_Type; }
+
+		// narrowest type whose indices reach vertexCount vertices
+		static GLenum getIndexType(unsigned int vertexCount);
+		// bytes of one index of type
+		static unsigned int getIndexSize(GLenum type);
+		// writes count indices as type to destination, the indices have to fit
+		static void pack(const unsigned int* indices, unsigned int count, GLenum type, void* destination);
+
+	private:
+		IndexBuffer(const void* indices, unsigned int primitiveCount, unsigned int componentCount, GLenum type, BufferUsage usage);
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,117 @@
+#include "mappablebuffer.h"
+#include "../glstate.h"
+#include "../glextensions.h"
+#include "persistentbuffer.h"
+
+#include <cstring>
+
+namespace graphics {
+
+	static GLenum getUsageHint(BufferUsage usage)
+	{
+		if (usage == STATIC_BUFFER)
+			return GL_STATIC_DRAW;
+		if (usage == DYNAMIC_BUFFER)
+			return GL_DYNAMIC_DRAW;
+		return GL_STREAM_DRAW;
+	}
+
+	MappableBuffer::MappableBuffer(const void* data, unsigned int size, BufferUsage usage)
+		:m_Size(size), m_Usage(usage), m_Mapped(nullptr), m_Copy(0), m_Mapping(false), m_MapOffset(0), m_MapSize(0), m_Stalls(0)
+	{
+		for (unsigned int i = 0; i < STREAM_COPIES; i++)
+			m_Fences[i] = 0;
+
+		// filled through the copy target, the array and element targets would attach the buffer
+		// to whatever vertex array is bound
+		glGenBuffers(1, &m_BufferID);
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_BufferID);
+
+		if (m_Usage == STREAM_BUFFER && GLExtensions::BufferStorage && m_Size > 0)
+			m_Mapped = PersistentBuffer::create(GL_COPY_WRITE_BUFFER, m_BufferID, m_Size * STREAM_COPIES, "MAPPABLEBUFFER");
+		m_Persistent = m_Mapped != nullptr;
+		if (m_Persistent && data != NULL)
+		{
+			for (unsigned int i = 0; i < STREAM_COPIES; i++)
+				std::memcpy(m_Mapped + i * m_Size, data, m_Size);
+		}
+		if (!m_Persistent)
+			glBufferData(GL_COPY_WRITE_BUFFER, m_Size, data, getUsageHint(m_Usage));
+	}
+
+	MappableBuffer::~MappableBuffer()
+	{
+		for (unsigned int i = 0; i < STREAM_COPIES; i++)
+			if (m_Fences[i] != 0)
+				glDeleteSync(m_Fences[i]);
+		if (m_Persistent)
+		{
+			GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_BufferID);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		}
+		GLState::deleteBuffer(m_BufferID);
+	}
+
+	void* MappableBuffer::map(unsigned int offset, unsigned int size)
+	{
+		if (m_Mapping)
+		{
+			std::cout << "ERROR::MAPPABLEBUFFER::ALREADY_MAPPED" << std::endl;
+			return nullptr;
+		}
+		if (size == 0 || offset + size > m_Size)
+		{
+			std::cout << "ERROR::MAPPABLEBUFFER::RANGE_OUT_OF_BOUNDS (" << offset << ", " << size << " of " << m_Size << " bytes)" << std::endl;
+			return nullptr;
+		}
+		m_Mapping = true;
+		m_MapOffset = offset;
+		m_MapSize = size;
+
+		if (!m_Persistent)
+		{
+			if (m_Staging.size() < size)
+				m_Staging.resize(size);
+			return &m_Staging[0];
+		}
+
+		// the copy the GPU finished reading longest ago
+		unsigned int previous = m_Copy;
+		m_Copy = (m_Copy + 1) % STREAM_COPIES;
+		if (PersistentBuffer::wait(m_Fences[m_Copy], "MAPPABLEBUFFER"))
+			m_Stalls++;
+
+		// the rest of the copy comes from the previous one, on the GPU so it stays ordered after
+		// the draws that read it
+		unsigned int end = offset + size;
+		GLState::bindBuffer(GL_COPY_READ_BUFFER, m_BufferID);
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_BufferID);
+		if (offset > 0)
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, previous * m_Size, m_Copy * m_Size, offset);
+		if (end < m_Size)
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, previous * m_Size + end, m_Copy * m_Size + end, m_Size - end);
+
+		// everything reading the previous copy has been issued by now
+		if (m_Fences[previous] != 0)
+			glDeleteSync(m_Fences[previous]);
+		m_Fences[previous] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		return m_Mapped + m_Copy * m_Size + offset;
+	}
+
+	void MappableBuffer::commit()
+	{
+		if (!m_Mapping)
+			return;
+		m_Mapping = false;
+		// coherent, the writes are visible to the next command already
+		if (m_Persistent)
+			return;
+
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_BufferID);
+		// fresh storage instead of waiting for the draws still reading the old contents
+		if (m_Usage != STATIC_BUFFER && m_MapOffset == 0 && m_MapSize == m_Size)
+			glBufferData(GL_COPY_WRITE_BUFFER, m_Size, NULL, getUsageHint(m_Usage));
+		glBufferSubData(GL_COPY_WRITE_BUFFER, m_MapOffset, m_MapSize, &m_Staging[0]);
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <iostream>
+#include <vector>
+
+namespace graphics {
+
+	// how often the contents of a VertexBuffer or IndexBuffer change
+	enum BufferUsage {
+		STATIC_BUFFER,	// written at creation, later maps are rare edits
+		DYNAMIC_BUFFER,	// rewritten now and then, whole rewrites orphan the old storage
+		STREAM_BUFFER	// rewritten every frame, persistently mapped copies fenced per frame
+	};
+
+	// GL buffer behind VertexBuffer and IndexBuffer, updated through map() and commit():
+	//
+	//   void* data = buffer->map(offset, size);
+	//   ... write size bytes ...
+	//   buffer->commit();
+	//
+	// static and dynamic buffers hand out a CPU copy of the range and upload it on commit. For a
+	// dynamic buffer, a map covering the whole buffer orphans it first so the upload doesn't wait
+	// for draws still reading the old contents.
+	//
+	// streamed buffers hold STREAM_COPIES copies in one immutable, persistently mapped store. Every
+	// map moves to the next copy, waiting on its fence only if the GPU is that far behind, and the
+	// CPU writes straight into it. Bytes outside the mapped range are carried over from the previous
+	// copy on the GPU. Draws have to read from getOffset(), which changes with every map; map at
+	// most once per frame or raise STREAM_COPIES. Without buffer storage streamed buffers behave
+	// like dynamic ones.
+	class MappableBuffer
+	{
+	public:
+		static const unsigned int STREAM_COPIES = 3;
+
+	protected:
+		unsigned int m_BufferID;
+		// bytes of one copy
+		unsigned int m_Size;
+		BufferUsage m_Usage;
+
+	private:
+		bool m_Persistent;
+		unsigned char* m_Mapped;
+		std::vector<unsigned char> m_Staging;
+
+		// copy draws read, and the fence of each copy's last reads
+		unsigned int m_Copy;
+		GLsync m_Fences[STREAM_COPIES];
+
+		bool m_Mapping;
+		unsigned int m_MapOffset, m_MapSize;
+
+		// maps that had to wait for the GPU before their copy could be reused
+		unsigned int m_Stalls;
+
+	public:
+		// data may be NULL, the contents are undefined until the first commit then
+		MappableBuffer(const void* data, unsigned int size, BufferUsage usage);
+		virtual ~MappableBuffer();
+
+		// write access to [offset, offset + size) until commit, nullptr if the range doesn't fit
+		// or a map is still open
+		void* map(unsigned int offset, unsigned int size);
+		inline void* map() { return map(0, m_Size); }
+		// makes the written range visible to the following draws
+		void commit();
+
+		inline unsigned int getBufferID() const { return m_BufferID; }
+		// byte offset of the current copy, 0 unless the buffer is streamed
+		inline unsigned int getOffset() const { return m_Copy * m_Size; }
+		inline unsigned int getSize() const { return m_Size; }
+		inline BufferUsage getUsage() const { return m_Usage; }
+		inline unsigned int getStalls() const { return m_Stalls; }
+	};
+}
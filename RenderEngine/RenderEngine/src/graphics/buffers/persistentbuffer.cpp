@@ -0,0 +1,44 @@
+#include "persistentbuffer.h"
+#include "../glstate.h"
+#include "../glextensions.h"
+
+namespace graphics {
+
+	unsigned char* PersistentBuffer::create(GLenum target, unsigned int &bufferID, unsigned int size, const char* owner)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLExtensions::BufferStorageProc(target, size, NULL, flags);
+		unsigned char* mapped = (unsigned char*)glMapBufferRange(target, 0, size, flags);
+		if (mapped != nullptr)
+			return mapped;
+
+		std::cout << "ERROR::" << owner << "::MAP_FAILED" << std::endl;
+		// the storage is immutable already, start over with a fresh buffer
+		GLState::deleteBuffer(bufferID);
+		glGenBuffers(1, &bufferID);
+		GLState::bindBuffer(target, bufferID);
+		return nullptr;
+	}
+
+	bool PersistentBuffer::wait(GLsync &fence, const char* owner)
+	{
+		if (fence == 0)
+			return false;
+
+		// normally signaled long ago, only a GPU running all copies behind blocks here
+		bool stalled = false;
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			stalled = true;
+			do {
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+		if (result == GL_WAIT_FAILED)
+			std::cout << "ERROR::" << owner << "::WAIT_FAILED" << std::endl;
+		glDeleteSync(fence);
+		fence = 0;
+		return stalled;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <iostream>
+
+namespace graphics {
+
+	// what RingBuffer and MappableBuffer share about buffers that stay mapped while the GPU reads
+	// them: creating the mapped storage, and waiting until the GPU is done with a region before
+	// the CPU writes it again. owner names the caller in error messages, like "RINGBUFFER"
+	class PersistentBuffer
+	{
+	public:
+		// gives the buffer bound at target immutable storage of size bytes, mapped coherently for
+		// writing. If the mapping fails the buffer is replaced by a fresh one without storage, bound
+		// at target, and nullptr is returned; the caller falls back to glBufferData. Needs
+		// GLExtensions::BufferStorage
+		static unsigned char* create(GLenum target, unsigned int &bufferID, unsigned int size, const char* owner);
+
+		// blocks until fence is signaled, then deletes it and sets it to 0. Nothing happens for
+		// fence 0. Returns true if the GPU wasn't done yet and the CPU had to wait
+		static bool wait(GLsync &fence, const char* owner);
+
+	private:
+		PersistentBuffer();
+	};
+}
@@ -0,0 +1,126 @@
+#include "ringbuffer.h"
+#include "../glstate.h"
+#include "../glextensions.h"
+#include "persistentbuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace graphics {
+
+	RingBuffer::RingBuffer(GLenum target, unsigned int frameSize)
+		:m_Target(target), m_Frame(0), m_Head(0), m_Mapped(nullptr), m_Stalls(0)
+	{
+		// every allocation starts at an offset the target accepts for glBindBufferRange
+		m_Alignment = getAlignment(m_Target);
+		m_FrameSize = (frameSize + m_Alignment - 1) / m_Alignment * m_Alignment;
+
+		for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; i++)
+			m_Fences[i] = 0;
+
+		unsigned int size = m_FrameSize * FRAMES_IN_FLIGHT;
+		glGenBuffers(1, &m_BufferID);
+		GLState::bindBuffer(m_Target, m_BufferID);
+
+		// coherent, so writes become visible to the GPU without explicit flushes
+		if (GLExtensions::BufferStorage)
+			m_Mapped = PersistentBuffer::create(m_Target, m_BufferID, size, "RINGBUFFER");
+		m_Persistent = m_Mapped != nullptr;
+		if (!m_Persistent)
+		{
+			glBufferData(m_Target, size, NULL, GL_STREAM_DRAW);
+			m_Staging.resize(size);
+			m_Mapped = &m_Staging[0];
+		}
+	}
+
+	RingBuffer::~RingBuffer()
+	{
+		for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; i++)
+			if (m_Fences[i] != 0)
+				glDeleteSync(m_Fences[i]);
+		if (m_Persistent)
+		{
+			GLState::bindBuffer(m_Target, m_BufferID);
+			glUnmapBuffer(m_Target);
+		}
+		GLState::deleteBuffer(m_BufferID);
+	}
+
+	void RingBuffer::beginFrame()
+	{
+		m_Head = 0;
+		if (PersistentBuffer::wait(m_Fences[m_Frame], "RINGBUFFER"))
+			m_Stalls++;
+	}
+
+	void RingBuffer::endFrame()
+	{
+		if (m_Persistent)
+			m_Fences[m_Frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_Frame = (m_Frame + 1) % FRAMES_IN_FLIGHT;
+	}
+
+	void* RingBuffer::allocate(unsigned int size, unsigned int &offset)
+	{
+		unsigned int aligned = (size + m_Alignment - 1) / m_Alignment * m_Alignment;
+		if (m_Head + aligned > m_FrameSize)
+		{
+			std::cout << "ERROR::RINGBUFFER::OUT_OF_SPACE (" << m_FrameSize << " bytes per frame)" << std::endl;
+			return nullptr;
+		}
+		offset = m_Frame * m_FrameSize + m_Head;
+		m_Head += aligned;
+		return m_Mapped + offset;
+	}
+
+	int RingBuffer::push(const void* data, unsigned int size)
+	{
+		unsigned int offset;
+		void* memory = allocate(size, offset);
+		if (memory == nullptr)
+			return -1;
+		std::memcpy(memory, data, size);
+		return offset;
+	}
+
+	void* RingBuffer::getFree(unsigned int &offset, unsigned int &size)
+	{
+		offset = m_Frame * m_FrameSize + m_Head;
+		size = m_FrameSize - m_Head;
+		return m_Mapped + offset;
+	}
+
+	void RingBuffer::commit(unsigned int size)
+	{
+		unsigned int aligned = (size + m_Alignment - 1) / m_Alignment * m_Alignment;
+		m_Head = std::min(m_Head + aligned, m_FrameSize);
+	}
+
+	void RingBuffer::bindRange(unsigned int binding, unsigned int offset, unsigned int size)
+	{
+		if (!m_Persistent)
+		{
+			GLState::bindBuffer(m_Target, m_BufferID);
+			glBufferSubData(m_Target, offset, size, m_Mapped + offset);
+		}
+		GLState::bindBufferRange(m_Target, binding, m_BufferID, offset, size);
+	}
+
+	unsigned int RingBuffer::getAlignment(GLenum target)
+	{
+		GLint alignment = 256;
+		if (target == GL_UNIFORM_BUFFER)
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		else if (target == GL_SHADER_STORAGE_BUFFER)
+			glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		return (unsigned int)alignment;
+	}
+
+	void RingBuffer::bind(unsigned int offset, unsigned int size)
+	{
+		GLState::bindBuffer(m_Target, m_BufferID);
+		if (!m_Persistent)
+			glBufferSubData(m_Target, offset, size, m_Mapped + offset);
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <iostream>
+#include <vector>
+
+namespace graphics {
+
+	// streaming buffer for constants that change every frame or every draw. The storage is split
+	// into one region per frame in flight; the CPU writes the current region through a persistent
+	// mapping while the GPU still reads the older ones, and a fence per region keeps a frame from
+	// overwriting data the GPU hasn't consumed yet. Draws only bind an offset into it.
+	//
+	// without buffer storage the allocations go to a CPU copy and are uploaded when they are bound.
+	class RingBuffer
+	{
+	public:
+		static const unsigned int FRAMES_IN_FLIGHT = 3;
+
+	private:
+		unsigned int m_BufferID;
+		GLenum m_Target;
+		unsigned int m_FrameSize;
+		unsigned int m_Alignment;
+
+		// current frame region and the write head inside it
+		unsigned int m_Frame;
+		unsigned int m_Head;
+		GLsync m_Fences[FRAMES_IN_FLIGHT];
+
+		bool m_Persistent;
+		unsigned char* m_Mapped;
+		std::vector<unsigned char> m_Staging;
+
+		// frames that had to wait for the GPU before their region could be reused
+		unsigned int m_Stalls;
+
+	public:
+		// frameSize is the space available to a single frame, the buffer holds FRAMES_IN_FLIGHT of them
+		RingBuffer(GLenum target, unsigned int frameSize);
+		~RingBuffer();
+
+		// waits until the GPU is done with the region this frame reuses, call before the first allocate
+		void beginFrame();
+		// fences the region written this frame
+		void endFrame();
+
+		// reserves size bytes aligned for binding, offset receives their position in the buffer.
+		// returns nullptr if the frame ran out of space
+		void* allocate(unsigned int size, unsigned int &offset);
+
+		// allocates and copies data in one go, returns the offset or -1
+		int push(const void* data, unsigned int size);
+
+		// for writers that don't know their size up front: the rest of this frame's region, offset
+		// and size receive where it lies. Nothing is allocated until commit(size), and nothing
+		// else may be allocated in between
+		void* getFree(unsigned int &offset, unsigned int &size);
+		// allocates the first size bytes of the last getFree
+		void commit(unsigned int size);
+
+		// binds [offset, offset + size) to an indexed binding point of the buffer's target
+		void bindRange(unsigned int binding, unsigned int offset, unsigned int size);
+		// binds the buffer to its target for targets read at an offset, like the commands of
+		// GL_DRAW_INDIRECT_BUFFER. [offset, offset + size) is the range that has to be current
+		void bind(unsigned int offset, unsigned int size);
+
+		inline unsigned int getBufferID() const { return m_BufferID; }
+		inline unsigned int getFrameSize() const { return m_FrameSize; }
+		inline unsigned int getAlignment() const { return m_Alignment; }
+		inline unsigned int getUsed() const { return m_Head; }
+		inline unsigned int getStalls() const { return m_Stalls; }
+		inline bool isPersistent() const { return m_Persistent; }
+
+		// offset alignment glBindBufferRange requires for target, every allocation is rounded up
+		// to it. Owners sizing a frame for several allocations add one alignment per allocation
+		static unsigned int getAlignment(GLenum target);
+	};
+}
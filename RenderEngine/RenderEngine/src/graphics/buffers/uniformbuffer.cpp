@@ -0,0 +1,42 @@
+#include "uniformbuffer.h"
+#include "../glstate.h"
+
+namespace graphics {
+	UniformBuffer::UniformBuffer(unsigned int size, unsigned int binding)
+		:m_Size(size), m_Binding(binding)
+	{
+		glGenBuffers(1, &m_UniformBufferID);
+		GLState::bindBuffer(GL_UNIFORM_BUFFER, m_UniformBufferID);
+		glBufferData(GL_UNIFORM_BUFFER, m_Size, NULL, GL_DYNAMIC_DRAW);
+		// blocks are bound once to their fixed binding point, shaders pick them up by layout(binding = N)
+		bind();
+	}
+
+	UniformBuffer::~UniformBuffer()
+	{
+		GLState::deleteBuffer(m_UniformBufferID);
+	}
+
+	void UniformBuffer::update(const void * data)
+	{
+		GLState::bindBuffer(GL_UNIFORM_BUFFER, m_UniformBufferID);
+		glBufferData(GL_UNIFORM_BUFFER, m_Size, data, GL_DYNAMIC_DRAW);
+	}
+
+	void UniformBuffer::updateRange(const void * data, unsigned int offset, unsigned int size)
+	{
+		GLState::bindBuffer(GL_UNIFORM_BUFFER, m_UniformBufferID);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	}
+
+	void UniformBuffer::bind() const
+	{
+		GLState::bindBufferBase(GL_UNIFORM_BUFFER, m_Binding, m_UniformBufferID);
+	}
+	void UniformBuffer::unbind() const
+	{
+#if GLSTATE_UNBIND
+		GLState::bindBufferBase(GL_UNIFORM_BUFFER, m_Binding, 0);
+#endif
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <iostream>
+
+namespace graphics {
+	class UniformBuffer
+	{
+	private:
+		unsigned int m_UniformBufferID;
+		unsigned int m_Size;
+		unsigned int m_Binding;
+
+	public:
+		UniformBuffer(unsigned int size, unsigned int binding);
+
+		~UniformBuffer();
+
+		// replaces the whole block, orphaning the previous storage so the driver never waits on it
+		void update(const void * data);
+		void updateRange(const void * data, unsigned int offset, unsigned int size);
+
+		void bind() const;
+		void unbind() const;
+
+		inline unsigned int getSize() { return m_Size; }
+		inline unsigned int getBinding() { return m_Binding; }
+	};
+}
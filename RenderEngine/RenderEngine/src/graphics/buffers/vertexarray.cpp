@@ -1,4 +1,5 @@
 #include "vertexarray.h"
+#include "../glstate.h"
 
 namespace graphics {
 
@@ -9,31 +10,85 @@ namespace graphics {
 
 	VertexArray::~VertexArray()
 	{
-		for (int i = 0; i < m_VertexBuffers.size(); i++)
-			delete m_VertexBuffers[i];
+		for (unsigned int i = 0; i < m_Attachments.size(); i++)
+			delete m_Attachments[i].buffer;
 
-		glDeleteVertexArrays(1, &m_VertexArrayID);
+		GLState::deleteVertexArray(m_VertexArrayID);
+	}
+
+	void VertexArray::addBuffer(VertexBuffer * vertexBuffer, const BufferLayout &layout)
+	{
+		Attachment attachment;
+		attachment.buffer = vertexBuffer;
+		attachment.layout = layout;
+		attachment.offset = vertexBuffer->getOffset();
+		unsigned int binding = (unsigned int)m_Attachments.size();
+		m_Attachments.push_back(attachment);
+
+		// the formats stay with the vertex array, the buffer is only referenced by the binding
+		bind();
+		layout.apply(binding);
+		glBindVertexBuffer(binding, vertexBuffer->getBufferID(), attachment.offset, layout.getStride());
+		unbind();
 	}
 
 	void VertexArray::addVertexBuffer(VertexBuffer * vertexBuffer, unsigned int index)
+	{
+		BufferLayout layout;
+		layout.add("", index, vertexBuffer->getComponentCount());
+		addBuffer(vertexBuffer, layout);
+	}
+
+	void VertexArray::addInstanceBuffer(VertexBuffer * vertexBuffer, unsigned int index, unsigned int divisor)
+	{
+		BufferLayout layout(divisor);
+		layout.add("", index, vertexBuffer->getComponentCount());
+		addBuffer(vertexBuffer, layout);
+	}
+
+	void VertexArray::SetAttribOffset(unsigned int location, unsigned int offset)
+	{
+		for (unsigned int i = 0; i < m_Attachments.size(); i++)
+		{
+			Attachment &attachment = m_Attachments[i];
+			if (!attachment.layout.setOffset(location, offset))
+				continue;
+			bind();
+			attachment.layout.apply(i);
+			glBindVertexBuffer(i, attachment.buffer->getBufferID(), attachment.offset, attachment.layout.getStride());
+			unbind();
+			return;
+		}
+		std::cout << "ERROR::VERTEXARRAY::NO_ATTRIBUTE_AT_LOCATION " << location << std::endl;
+	}
+
+	void VertexArray::drawInstanced(const IndexBuffer* indices, unsigned int instanceCount) const
 	{
 		bind();
-		vertexBuffer->bind();
-		glEnableVertexAttribArray(index);
-		glVertexAttribPointer(index, vertexBuffer->getComponentCount(), GL_FLOAT, GL_FALSE,
-			vertexBuffer->getComponentCount() * sizeof(float), (void*)(0));
-		vertexBuffer->unbind();
+		indices->bind();
+		glDrawElementsInstanced(GL_TRIANGLES, indices->getIndexCount(), indices->getType(), (void*)(size_t)indices->getOffset(), instanceCount);
 		unbind();
 	}
 
 	void VertexArray::bind() const
 	{
-		glBindVertexArray(m_VertexArrayID);
+		GLState::bindVertexArray(m_VertexArrayID);
+		for (unsigned int i = 0; i < m_Attachments.size(); i++)
+		{
+			Attachment &attachment = m_Attachments[i];
+			if (attachment.buffer->getOffset() != attachment.offset)
+			{
+				attachment.offset = attachment.buffer->getOffset();
+				glBindVertexBuffer(i, attachment.buffer->getBufferID(), attachment.offset, attachment.layout.getStride());
+			}
+		}
 	}
 
 	void VertexArray::unbind() const
 	{
-		glBindVertexArray(0);
+#if GLSTATE_UNBIND
+		GLState::bindVertexArray(0);
+#endif
 	}
 
 }
\ No newline at end of file
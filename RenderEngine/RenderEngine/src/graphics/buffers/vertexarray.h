@@ -3,7 +3,9 @@
 #include <glad/glad.h>
 #include <vector>
 
+#include "bufferlayout.h"
 #include "vertexbuffer.h"
+#include "indexbuffer.h"
 
 
 namespace graphics {
@@ -11,19 +13,39 @@ namespace graphics {
 	class VertexArray
 	{
 	private:
+		// a buffer with its layout, bound at the binding point of its position in m_Attachments,
+		// and the byte offset it was bound with. Streamed buffers move to another copy on every
+		// map, bind() moves the binding point along
+		struct Attachment {
+			VertexBuffer* buffer;
+			BufferLayout layout;
+			unsigned int offset;
+		};
+
 		unsigned int m_VertexArrayID;
-		std::vector<VertexBuffer*> m_VertexBuffers;
+		mutable std::vector<Attachment> m_Attachments;
 
 	public:
 
 		VertexArray();
 		~VertexArray();
 
+		// every attribute of layout read from one buffer, interleaved or not. The vertex array
+		// takes ownership of the buffer
+		void addBuffer(VertexBuffer * vertexBuffer, const BufferLayout &layout);
+		// a single tightly packed float attribute per buffer
 		void addVertexBuffer(VertexBuffer * vertexBuffer, unsigned int index);
-		void SetAttribOffset();
+		// an attribute that advances once per divisor instances instead of once per vertex
+		void addInstanceBuffer(VertexBuffer * vertexBuffer, unsigned int index, unsigned int divisor = 1);
+		// moves the attribute at location inside its buffer's vertices
+		void SetAttribOffset(unsigned int location, unsigned int offset);
 		void bind() const;
 		void unbind() const;
 
+		// triangles of indices, instanceCount times. Per-instance data comes from instance
+		// attributes or the bound Instances range, see DrawTransforms::push
+		void drawInstanced(const IndexBuffer* indices, unsigned int instanceCount) const;
+
 
 	};
 
@@ -1,25 +1,30 @@
 #include "vertexbuffer.h"
+#include "../glstate.h"
 
 namespace graphics {
-	VertexBuffer::VertexBuffer(float * vertices, unsigned int vertexCount, unsigned int componentCount)
-		:m_VertexCount(vertexCount), m_ComponentCount(componentCount)
+	VertexBuffer::VertexBuffer(float * vertices, unsigned int vertexCount, unsigned int componentCount, BufferUsage usage)
+		:MappableBuffer(vertices, vertexCount * componentCount * sizeof(float), usage),
+		m_VertexCount(vertexCount), m_ComponentCount(componentCount), m_Stride(componentCount * sizeof(float))
+	{
+	}
+
+	VertexBuffer::VertexBuffer(const void * vertices, unsigned int vertexCount, const BufferLayout &layout, BufferUsage usage)
+		:MappableBuffer(vertices, vertexCount * layout.getStride(), usage),
+		m_VertexCount(vertexCount), m_ComponentCount(layout.getComponentCount()), m_Stride(layout.getStride())
 	{
-		glGenBuffers(1, &m_VertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, m_VertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, m_VertexCount* m_ComponentCount * sizeof(float), vertices, GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
 	VertexBuffer::~VertexBuffer()
 	{
-		glDeleteBuffers(1, &m_VertexBufferID);
 	}
 	void VertexBuffer::bind() const
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, m_VertexBufferID);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, m_BufferID);
 	}
 	void VertexBuffer::unbind() const
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+#if GLSTATE_UNBIND
+		GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+#endif
 	}
 }
\ No newline at end of file
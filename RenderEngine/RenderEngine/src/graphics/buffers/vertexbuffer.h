@@ -3,23 +3,31 @@
 #include <glad/glad.h>
 #include <iostream>
 
+#include "bufferlayout.h"
+#include "mappablebuffer.h"
+
 namespace graphics {
-		class VertexBuffer
+		// vertices of a BufferLayout, or tightly packed floats with componentCount per vertex.
+		// Non-static buffers are updated through map and commit, see MappableBuffer
+		class VertexBuffer : public MappableBuffer
 		{
 		private:
-			unsigned int m_VertexBufferID;
 			unsigned int m_VertexCount;
 			unsigned int m_ComponentCount;
+			unsigned int m_Stride;
 
 		public:
-			VertexBuffer(float * vertices, unsigned int vertexCount, unsigned int componentCount);
+			VertexBuffer(float * vertices, unsigned int vertexCount, unsigned int componentCount, BufferUsage usage = STATIC_BUFFER);
+			// vertexCount vertices of layout's stride, the component count is the layout's
+			VertexBuffer(const void * vertices, unsigned int vertexCount, const BufferLayout &layout, BufferUsage usage = STATIC_BUFFER);
 
 			~VertexBuffer();
 
 			void bind() const;
 			void unbind() const;
 
-			inline unsigned int getVertexCount() { return m_VertexCount; }
-			inline unsigned int getComponentCount() { return m_ComponentCount; }
+			inline unsigned int getVertexCount() const { return m_VertexCount; }
+			inline unsigned int getComponentCount() const { return m_ComponentCount; }
+			inline unsigned int getStride() const { return m_Stride; }
 		};
 }
\ No newline at end of file
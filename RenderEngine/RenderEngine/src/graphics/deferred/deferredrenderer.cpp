@@ -0,0 +1,126 @@
+#include "deferredrenderer.h"
+#include "../glstate.h"
+
+namespace graphics {
+
+	DeferredRenderer::DeferredRenderer(unsigned int width, unsigned int height, bool async)
+	{
+		m_GBuffer = new GBuffer(width, height);
+		m_GeometryShaders = new ShaderLibrary("resources/shaders/model.vs", "resources/shaders/gbuffer.fs", nullptr, async);
+		m_LightShaders = new ShaderLibrary("resources/shaders/deferred_light.vs", "resources/shaders/deferred_light.fs", nullptr, async);
+
+		// cube from -0.5 to 0.5, counter-clockwise seen from outside
+		float positions[] = {
+			-0.5f, -0.5f, -0.5f,
+			0.5f, -0.5f, -0.5f,
+			0.5f,  0.5f, -0.5f,
+			-0.5f,  0.5f, -0.5f,
+			-0.5f, -0.5f,  0.5f,
+			0.5f, -0.5f,  0.5f,
+			0.5f,  0.5f,  0.5f,
+			-0.5f,  0.5f,  0.5f
+		};
+		unsigned char indices[] = {
+			0, 2, 1, 0, 3, 2,	// -z
+			4, 5, 6, 4, 6, 7,	// +z
+			0, 4, 7, 0, 7, 3,	// -x
+			1, 2, 6, 1, 6, 5,	// +x
+			0, 1, 5, 0, 5, 4,	// -y
+			3, 7, 6, 3, 6, 2	// +y
+		};
+		m_VolumeVAO = new VertexArray();
+		m_VolumeVAO->addVertexBuffer(new VertexBuffer(positions, 8, 3), 0);
+		m_VolumeIBO = new IndexBuffer(indices, 12, 3);
+		m_VolumeVAO->bind();
+		m_VolumeIBO->bind();
+		m_VolumeVAO->unbind();
+
+		glGenVertexArrays(1, &m_EmptyVAO);
+	}
+
+	DeferredRenderer::~DeferredRenderer()
+	{
+		GLState::deleteVertexArray(m_EmptyVAO);
+		delete m_VolumeIBO;
+		delete m_VolumeVAO;
+		delete m_LightShaders;
+		delete m_GeometryShaders;
+		delete m_GBuffer;
+	}
+
+	void DeferredRenderer::resize(unsigned int width, unsigned int height)
+	{
+		m_GBuffer->resize(width, height);
+	}
+
+	void DeferredRenderer::beginGeometryPass()
+	{
+		m_GBuffer->bindForWriting();
+		GLState::setBlend(false);
+		GLState::setDepthTest(true);
+		GLState::setDepthFunc(GL_LESS);
+	}
+
+	void DeferredRenderer::endGeometryPass()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, m_GBuffer->getWidth(), m_GBuffer->getHeight());
+	}
+
+	void DeferredRenderer::lightingPass(const glm::mat4 &viewProjection, const ShaderDefines &sceneDefines, unsigned int pointLightCount, RingBuffer* constants)
+	{
+		// the scene depth goes to the default framebuffer first, the volume pass tests against it
+		m_GBuffer->blitDepth();
+		m_GBuffer->bindForReading();
+
+		DeferredBlock block;
+		block.invViewProjection = glm::inverse(viewProjection);
+		block.screenSize = glm::vec4(m_GBuffer->getWidth(), m_GBuffer->getHeight(), 1.0f / m_GBuffer->getWidth(), 1.0f / m_GBuffer->getHeight());
+		int blockOffset = constants->push(&block, sizeof(DeferredBlock));
+		if (blockOffset < 0)
+			return;
+		constants->bindRange(DEFERRED_BLOCK_BINDING, blockOffset, sizeof(DeferredBlock));
+
+		// full-screen pass: directional and spot light, overwrites every pixel with geometry
+		Shader* fullscreen = m_LightShaders->get(sceneDefines);
+		GLState::setDepthMask(false);
+		GLState::setDepthTest(false);
+		if (fullscreen->isReady())
+		{
+			fullscreen->enable();
+			GLState::bindVertexArray(m_EmptyVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+
+		// volume pass: back faces of each light's cube that lie behind the scene surface, so
+		// only pixels the light can reach are shaded. Depth clamp keeps volumes crossing the far
+		// plane, front face culling keeps them when the camera is inside
+		ShaderDefines volumeDefines = sceneDefines;
+		volumeDefines.set("LIGHT_VOLUME", 1);
+		Shader* volume = m_LightShaders->get(volumeDefines);
+		if (pointLightCount > 0 && volume->isReady())
+		{
+			GLState::setDepthTest(true);
+			GLState::setDepthFunc(GL_GEQUAL);
+			GLState::setCullFace(true);
+			GLState::setCullMode(GL_FRONT);
+			GLState::setBlend(true);
+			GLState::setBlendFunc(GL_ONE, GL_ONE);
+			glEnable(GL_DEPTH_CLAMP);
+
+			volume->enable();
+			m_VolumeVAO->bind();
+			glDrawElementsInstanced(GL_TRIANGLES, m_VolumeIBO->getIndexCount(), m_VolumeIBO->getType(), 0, pointLightCount);
+
+			glDisable(GL_DEPTH_CLAMP);
+			GLState::setBlend(false);
+			GLState::setCullMode(GL_BACK);
+			GLState::setCullFace(false);
+		}
+
+		// back to the forward defaults
+		GLState::setDepthTest(true);
+		GLState::setDepthFunc(GL_LESS);
+		GLState::setDepthMask(true);
+	}
+}
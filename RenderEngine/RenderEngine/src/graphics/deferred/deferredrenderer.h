@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <iostream>
+
+#include "gbuffer.h"
+#include "../shaderlibrary.h"
+#include "../uniformblocks.h"
+#include "../buffers/ringbuffer.h"
+#include "../buffers/vertexarray.h"
+#include "../buffers/indexbuffer.h"
+
+namespace graphics {
+
+	// Deferred alternative to the forward model.fs path. Meshes are drawn once into the G-buffer
+	// with gbuffer.fs, then lighting runs per pixel that is actually visible:
+	//   - one full-screen pass for the directional and spot light (and background rejection)
+	//   - point lights as instanced light volumes, a cube around each light's radius whose back
+	//     faces are depth tested against the scene, blended additively
+	// so overdrawn fragments only pay for the G-buffer write.
+	class DeferredRenderer
+	{
+	private:
+		GBuffer* m_GBuffer;
+		ShaderLibrary* m_GeometryShaders;
+		ShaderLibrary* m_LightShaders;
+
+		// unit cube the light volumes are scaled from, and an empty vertex array for the
+		// full-screen triangle which is generated from gl_VertexID
+		VertexArray* m_VolumeVAO;
+		IndexBuffer* m_VolumeIBO;
+		unsigned int m_EmptyVAO;
+
+	public:
+		DeferredRenderer(unsigned int width, unsigned int height, bool async = false);
+		~DeferredRenderer();
+
+		void resize(unsigned int width, unsigned int height);
+
+		// programs for the geometry pass, pass them to Model::Draw between begin and end
+		inline ShaderLibrary* getGeometryShaders() const { return m_GeometryShaders; }
+		void beginGeometryPass();
+		void endGeometryPass();
+
+		// shades the G-buffer into the default framebuffer and leaves the scene depth there for
+		// forward passes drawn afterwards. USE_DIR_LIGHT / USE_SPOT_LIGHT are taken from sceneDefines,
+		// the point lights are the pointLightCount lights bound at POINT_LIGHT_STORAGE_BINDING
+		void lightingPass(const glm::mat4 &viewProjection, const ShaderDefines &sceneDefines, unsigned int pointLightCount, RingBuffer* constants);
+	};
+}
@@ -0,0 +1,86 @@
+#include "gbuffer.h"
+#include "../glstate.h"
+
+namespace graphics {
+
+	GBuffer::GBuffer(unsigned int width, unsigned int height)
+		:m_Width(width), m_Height(height)
+	{
+		create();
+	}
+
+	GBuffer::~GBuffer()
+	{
+		destroy();
+	}
+
+	void GBuffer::resize(unsigned int width, unsigned int height)
+	{
+		if (width == m_Width && height == m_Height)
+			return;
+		destroy();
+		m_Width = width;
+		m_Height = height;
+		create();
+	}
+
+	void GBuffer::create()
+	{
+		glGenFramebuffers(1, &m_FramebufferID);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_FramebufferID);
+
+		// immutable storage, nearest filtering since every pass reads texel exact with texelFetch
+		unsigned int* textures[3] = { &m_AlbedoID, &m_NormalID, &m_DepthID };
+		GLenum formats[3] = { GL_RGBA8, GL_RGB10_A2, GL_DEPTH24_STENCIL8 };
+		GLenum attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_DEPTH_STENCIL_ATTACHMENT };
+		for (int i = 0; i < 3; i++)
+		{
+			glGenTextures(1, textures[i]);
+			GLState::bindTexture(0, GL_TEXTURE_2D, *textures[i]);
+			glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], m_Width, m_Height);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[i], GL_TEXTURE_2D, *textures[i], 0);
+		}
+		GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR::GBUFFER::FRAMEBUFFER_INCOMPLETE" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void GBuffer::destroy()
+	{
+		GLState::deleteTexture(m_AlbedoID);
+		GLState::deleteTexture(m_NormalID);
+		GLState::deleteTexture(m_DepthID);
+		glDeleteFramebuffers(1, &m_FramebufferID);
+	}
+
+	void GBuffer::bindForWriting() const
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_FramebufferID);
+		glViewport(0, 0, m_Width, m_Height);
+		// every covered pixel is overwritten, only the depth has to start out cleared
+		GLState::setDepthMask(true);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	void GBuffer::bindForReading() const
+	{
+		GLState::bindTexture(GBUFFER_ALBEDO_UNIT, GL_TEXTURE_2D, m_AlbedoID);
+		GLState::bindTexture(GBUFFER_NORMAL_UNIT, GL_TEXTURE_2D, m_NormalID);
+		GLState::bindTexture(GBUFFER_DEPTH_UNIT, GL_TEXTURE_2D, m_DepthID);
+	}
+
+	void GBuffer::blitDepth() const
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_FramebufferID);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, m_Width, m_Height, 0, 0, m_Width, m_Height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+}
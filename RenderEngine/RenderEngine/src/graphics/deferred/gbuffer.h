@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <iostream>
+
+namespace graphics {
+
+	// texture units the lighting passes read the G-buffer from
+	enum GBufferUnit {
+		GBUFFER_ALBEDO_UNIT = 0,
+		GBUFFER_NORMAL_UNIT = 1,
+		GBUFFER_DEPTH_UNIT = 2
+	};
+
+	// Geometry buffer of the deferred path, 12 bytes per pixel:
+	//   0: RGBA8      albedo, specular intensity
+	//   1: RGB10_A2   octahedral normal (xy), shininess / 256 (z)
+	//   depth: DEPTH24_STENCIL8, world position is reconstructed from it. Same format as the
+	//          default framebuffer, so it can be blitted there
+	class GBuffer
+	{
+	private:
+		unsigned int m_FramebufferID;
+		unsigned int m_AlbedoID, m_NormalID, m_DepthID;
+		unsigned int m_Width, m_Height;
+
+	public:
+		GBuffer(unsigned int width, unsigned int height);
+		~GBuffer();
+
+		// reallocates the attachments, call when the window size changes
+		void resize(unsigned int width, unsigned int height);
+
+		// binds the framebuffer for the geometry pass and clears it
+		void bindForWriting() const;
+		// binds the attachments at their GBufferUnit texture units
+		void bindForReading() const;
+		// copies the depth attachment into the default framebuffer so forward passes can depth test against it
+		void blitDepth() const;
+
+		inline unsigned int getWidth() const { return m_Width; }
+		inline unsigned int getHeight() const { return m_Height; }
+
+	private:
+		void create();
+		void destroy();
+	};
+}
@@ -0,0 +1,129 @@
+#include "drawtransforms.h"
+
+#include <cmath>
+
+// four matrices per instruction on any x86 target, one at a time elsewhere
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define DRAWTRANSFORMS_SSE 1
+#include <xmmintrin.h>
+#else
+#define DRAWTRANSFORMS_SSE 0
+#endif
+
+namespace graphics {
+
+	std::vector<unsigned int> DrawTransforms::s_General;
+
+	void DrawTransforms::compute(const glm::mat4* models, unsigned int count, DrawBlock* out)
+	{
+		s_General.clear();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const glm::mat4 &m = models[i];
+			out[i].model = m;
+			// inverse transpose of s * R is R / s, which is the upper 3x3 divided by s^2
+			float scaleSquared;
+			if (isUniformScale(m, scaleSquared))
+			{
+				float invScaleSquared = 1.0f / scaleSquared;
+				out[i].normalMatrix[0] = glm::vec4(glm::vec3(m[0]) * invScaleSquared, 0.0f);
+				out[i].normalMatrix[1] = glm::vec4(glm::vec3(m[1]) * invScaleSquared, 0.0f);
+				out[i].normalMatrix[2] = glm::vec4(glm::vec3(m[2]) * invScaleSquared, 0.0f);
+			}
+			else
+				s_General.push_back(i);
+		}
+
+		unsigned int general = (unsigned int)s_General.size();
+		unsigned int i = 0;
+#if DRAWTRANSFORMS_SSE
+		// the inverse transpose is the cofactor matrix over the determinant, and the cofactor
+		// columns are cross products of the model columns. Four matrices are transposed into
+		// x, y, z registers so each cross product is six multiplies for all of them
+		for (; i + 4 <= general; i += 4)
+		{
+			const glm::mat4* m[4] = { &models[s_General[i]], &models[s_General[i + 1]], &models[s_General[i + 2]], &models[s_General[i + 3]] };
+
+			__m128 x[3], y[3], z[3];
+			for (int c = 0; c < 3; c++)
+			{
+				__m128 c0 = _mm_loadu_ps(&(*m[0])[c][0]);
+				__m128 c1 = _mm_loadu_ps(&(*m[1])[c][0]);
+				__m128 c2 = _mm_loadu_ps(&(*m[2])[c][0]);
+				__m128 c3 = _mm_loadu_ps(&(*m[3])[c][0]);
+				_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+				x[c] = c0; y[c] = c1; z[c] = c2;
+			}
+
+			// cofactor column a = column b x column c
+			__m128 cx[3], cy[3], cz[3];
+			for (int a = 0; a < 3; a++)
+			{
+				int b = (a + 1) % 3, c = (a + 2) % 3;
+				cx[a] = _mm_sub_ps(_mm_mul_ps(y[b], z[c]), _mm_mul_ps(z[b], y[c]));
+				cy[a] = _mm_sub_ps(_mm_mul_ps(z[b], x[c]), _mm_mul_ps(x[b], z[c]));
+				cz[a] = _mm_sub_ps(_mm_mul_ps(x[b], y[c]), _mm_mul_ps(y[b], x[c]));
+			}
+
+			// singular matrices get a zero normal matrix instead of infinities
+			__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], cx[0]), _mm_mul_ps(y[0], cy[0])), _mm_mul_ps(z[0], cz[0]));
+			__m128 nonZero = _mm_cmpneq_ps(det, _mm_setzero_ps());
+			__m128 invDet = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), det), nonZero);
+
+			for (int a = 0; a < 3; a++)
+			{
+				__m128 r0 = _mm_mul_ps(cx[a], invDet);
+				__m128 r1 = _mm_mul_ps(cy[a], invDet);
+				__m128 r2 = _mm_mul_ps(cz[a], invDet);
+				__m128 r3 = _mm_setzero_ps();
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+				_mm_storeu_ps(&out[s_General[i]].normalMatrix[a][0], r0);
+				_mm_storeu_ps(&out[s_General[i + 1]].normalMatrix[a][0], r1);
+				_mm_storeu_ps(&out[s_General[i + 2]].normalMatrix[a][0], r2);
+				_mm_storeu_ps(&out[s_General[i + 3]].normalMatrix[a][0], r3);
+			}
+		}
+#endif
+		for (; i < general; i++)
+			computeGeneral(models[s_General[i]], out[s_General[i]]);
+	}
+
+	bool DrawTransforms::isUniformScale(const glm::mat4 &model, float &scaleSquared)
+	{
+		glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+		float l0 = glm::dot(c0, c0);
+		float tolerance = l0 * 1e-4f;
+		scaleSquared = l0;
+		return l0 > 0.0f
+			&& std::abs(glm::dot(c1, c1) - l0) <= tolerance
+			&& std::abs(glm::dot(c2, c2) - l0) <= tolerance
+			&& std::abs(glm::dot(c0, c1)) <= tolerance
+			&& std::abs(glm::dot(c1, c2)) <= tolerance
+			&& std::abs(glm::dot(c2, c0)) <= tolerance;
+	}
+
+	bool DrawTransforms::push(const glm::mat4* models, unsigned int count, RingBuffer* instances)
+	{
+		unsigned int size = count * sizeof(DrawBlock);
+		unsigned int offset;
+		DrawBlock* blocks = (DrawBlock*)instances->allocate(size, offset);
+		if (blocks == nullptr)
+			return false;
+		compute(models, count, blocks);
+		instances->bindRange(INSTANCE_STORAGE_BINDING, offset, size);
+		return true;
+	}
+
+	void DrawTransforms::computeGeneral(const glm::mat4 &model, DrawBlock &out)
+	{
+		glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+		glm::vec3 cofactor0 = glm::cross(c1, c2);
+		glm::vec3 cofactor1 = glm::cross(c2, c0);
+		glm::vec3 cofactor2 = glm::cross(c0, c1);
+		float det = glm::dot(c0, cofactor0);
+		float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+		out.normalMatrix[0] = glm::vec4(cofactor0 * invDet, 0.0f);
+		out.normalMatrix[1] = glm::vec4(cofactor1 * invDet, 0.0f);
+		out.normalMatrix[2] = glm::vec4(cofactor2 * invDet, 0.0f);
+	}
+}
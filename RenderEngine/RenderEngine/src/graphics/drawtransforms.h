@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "uniformblocks.h"
+#include "buffers/ringbuffer.h"
+
+namespace graphics {
+
+	// Builds the per-instance blocks (model matrix plus normal matrix) of a batch of objects, so
+	// the vertex shader doesn't invert the model matrix for every vertex. Transforms with a uniform
+	// scale take the shortcut, the rotation part divided by the squared scale. Everything else
+	// goes through the cofactor matrix, four objects per SSE instruction.
+	class DrawTransforms
+	{
+	private:
+		// objects that need the general path, gathered once per compute call
+		static std::vector<unsigned int> s_General;
+
+	public:
+		// writes count blocks to out in order, out may be write-only mapped memory
+		static void compute(const glm::mat4* models, unsigned int count, DrawBlock* out);
+
+		// computes the blocks straight into a storage buffer ring and binds them to the Instances
+		// block at INSTANCE_STORAGE_BINDING, instance i of the next draws reads models[i].
+		// False if the frame ran out of space
+		static bool push(const glm::mat4* models, unsigned int count, RingBuffer* instances);
+
+		// upper 3x3 is a rotation times one scale factor, the squared factor goes to scaleSquared
+		static bool isUniformScale(const glm::mat4 &model, float &scaleSquared);
+
+	private:
+		DrawTransforms();
+		static void computeGeneral(const glm::mat4 &model, DrawBlock &out);
+	};
+}
@@ -0,0 +1,57 @@
+#include "frustum.h"
+
+namespace graphics {
+
+	Frustum::Frustum()
+	{
+		for (int i = 0; i < PLANE_COUNT; i++)
+			m_Planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	Frustum::Frustum(const glm::mat4 &viewProjection)
+	{
+		update(viewProjection);
+	}
+
+	void Frustum::update(const glm::mat4 &viewProjection)
+	{
+		// Gribb/Hartmann: each plane is the last row of the matrix plus or minus one of the others.
+		// glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++)
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+		m_Planes[LEFT] = rows[3] + rows[0];
+		m_Planes[RIGHT] = rows[3] - rows[0];
+		m_Planes[BOTTOM] = rows[3] + rows[1];
+		m_Planes[TOP] = rows[3] - rows[1];
+		m_Planes[NEAR_PLANE] = rows[3] + rows[2];
+		m_Planes[FAR_PLANE] = rows[3] - rows[2];
+
+		// normalized so plane distances are real distances, sphere tests need that
+		for (int i = 0; i < PLANE_COUNT; i++)
+			m_Planes[i] /= glm::length(glm::vec3(m_Planes[i]));
+	}
+
+	bool Frustum::intersectsSphere(const glm::vec3 &center, float radius) const
+	{
+		for (int i = 0; i < PLANE_COUNT; i++)
+			if (glm::dot(glm::vec3(m_Planes[i]), center) + m_Planes[i].w < -radius)
+				return false;
+		return true;
+	}
+
+	bool Frustum::intersectsBox(const glm::vec3 &min, const glm::vec3 &max) const
+	{
+		for (int i = 0; i < PLANE_COUNT; i++)
+		{
+			// the corner furthest along the plane normal
+			glm::vec3 corner(m_Planes[i].x >= 0.0f ? max.x : min.x,
+				m_Planes[i].y >= 0.0f ? max.y : min.y,
+				m_Planes[i].z >= 0.0f ? max.z : min.z);
+			if (glm::dot(glm::vec3(m_Planes[i]), corner) + m_Planes[i].w < 0.0f)
+				return false;
+		}
+		return true;
+	}
+}
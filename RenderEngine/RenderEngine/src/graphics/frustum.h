@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace graphics {
+
+	// view frustum as six normalized planes, a point p is inside a plane when
+	// dot(plane.xyz, p) + plane.w >= 0
+	class Frustum
+	{
+	public:
+		enum Plane { LEFT = 0, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE, PLANE_COUNT };
+
+	private:
+		glm::vec4 m_Planes[PLANE_COUNT];
+
+	public:
+		Frustum();
+		// planes of a projection * view matrix, in the space the matrix transforms from
+		Frustum(const glm::mat4 &viewProjection);
+
+		void update(const glm::mat4 &viewProjection);
+
+		bool intersectsSphere(const glm::vec3 &center, float radius) const;
+		bool intersectsBox(const glm::vec3 &min, const glm::vec3 &max) const;
+
+		inline const glm::vec4 &getPlane(unsigned int plane) const { return m_Planes[plane]; }
+	};
+}
@@ -0,0 +1,45 @@
+#include "glextensions.h"
+
+#include <cstring>
+
+namespace graphics {
+
+	bool GLExtensions::ParallelShaderCompile = false;
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC GLExtensions::MaxShaderCompilerThreads = nullptr;
+	bool GLExtensions::BufferStorage = false;
+	PFNGLBUFFERSTORAGEPROC GLExtensions::BufferStorageProc = nullptr;
+
+	void GLExtensions::load()
+	{
+		// parallel shader compilation, KHR and ARB share the same tokens
+		if (hasExtension("GL_KHR_parallel_shader_compile"))
+			MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		else if (hasExtension("GL_ARB_parallel_shader_compile"))
+			MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+		ParallelShaderCompile = MaxShaderCompilerThreads != nullptr;
+		if (ParallelShaderCompile)
+			// let the driver pick as many compiler threads as it likes
+			MaxShaderCompilerThreads(0xFFFFFFFF);
+
+		// buffer storage, core since 4.4 so the entry point may exist without the extension string
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major > 4 || (major == 4 && minor >= 4) || hasExtension("GL_ARB_buffer_storage"))
+			BufferStorageProc = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+		BufferStorage = BufferStorageProc != nullptr;
+	}
+
+	bool GLExtensions::hasExtension(const char* name)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (extension != nullptr && std::strcmp(extension, name) == 0)
+				return true;
+		}
+		return false;
+	}
+}
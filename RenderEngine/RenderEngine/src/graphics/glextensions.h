@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+
+// tokens and entry points newer than the GL 4.3 core profile our glad loader was generated for.
+// they are resolved at runtime, check the matching flag before using them.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+namespace graphics {
+	class GLExtensions
+	{
+	public:
+		// GL_KHR_parallel_shader_compile / GL_ARB_parallel_shader_compile
+		static bool ParallelShaderCompile;
+		static PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreads;
+		// GL 4.4 / GL_ARB_buffer_storage, immutable storage that can stay mapped while in use
+		static bool BufferStorage;
+		static PFNGLBUFFERSTORAGEPROC BufferStorageProc;
+
+	public:
+		// loads everything the context offers, call once after glad has been initialized
+		static void load();
+
+		static bool hasExtension(const char* name);
+	};
+}
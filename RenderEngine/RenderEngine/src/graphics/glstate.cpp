@@ -0,0 +1,332 @@
+#include "glstate.h"
+
+namespace graphics {
+
+	GLuint GLState::s_Program = 0;
+	GLuint GLState::s_VertexArray = 0;
+	GLuint GLState::s_ElementBuffer = 0;
+	GLuint GLState::s_Buffers[8] = { 0 };
+	unsigned int GLState::s_ActiveTexture = 0;
+	GLuint GLState::s_Textures[GLState::MAX_TEXTURE_UNITS][4] = { { 0 } };
+	GLuint GLState::s_UniformBindings[GLState::MAX_BUFFER_BINDINGS] = { 0 };
+	GLintptr GLState::s_UniformOffsets[GLState::MAX_BUFFER_BINDINGS] = { 0 };
+	GLsizeiptr GLState::s_UniformSizes[GLState::MAX_BUFFER_BINDINGS] = { 0 };
+	GLuint GLState::s_StorageBindings[GLState::MAX_BUFFER_BINDINGS] = { 0 };
+	GLintptr GLState::s_StorageOffsets[GLState::MAX_BUFFER_BINDINGS] = { 0 };
+	GLsizeiptr GLState::s_StorageSizes[GLState::MAX_BUFFER_BINDINGS] = { 0 };
+	// GL defaults
+	int GLState::s_DepthTest = 0;
+	int GLState::s_Blend = 0;
+	int GLState::s_CullFace = 0;
+	int GLState::s_DepthMask = 1;
+	GLenum GLState::s_DepthFunc = GL_LESS;
+	GLenum GLState::s_BlendSrc = GL_ONE;
+	GLenum GLState::s_BlendDst = GL_ZERO;
+	GLenum GLState::s_CullMode = GL_BACK;
+	std::unordered_map<GLuint, GLuint> GLState::s_ElementBuffers;
+	GLStateStats GLState::s_Stats = { 0, 0, 0 };
+
+	// returns true when the call has to reach GL
+	// ------------------------------------------
+	bool GLState::update(GLuint &current, GLuint value)
+	{
+		if (current == value)
+		{
+			s_Stats.skipped++;
+			return false;
+		}
+		current = value;
+		s_Stats.issued++;
+		return true;
+	}
+
+	bool GLState::updateFlag(int &current, bool value, GLenum cap)
+	{
+		int flag = value ? 1 : 0;
+		if (current == flag)
+		{
+			s_Stats.skipped++;
+			return false;
+		}
+		current = flag;
+		s_Stats.issued++;
+		if (value)
+			glEnable(cap);
+		else
+			glDisable(cap);
+		return true;
+	}
+
+	int GLState::getBufferSlot(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER: return 0;
+		case GL_UNIFORM_BUFFER: return 1;
+		case GL_SHADER_STORAGE_BUFFER: return 2;
+		case GL_DRAW_INDIRECT_BUFFER: return 3;
+		case GL_COPY_READ_BUFFER: return 4;
+		case GL_COPY_WRITE_BUFFER: return 5;
+		case GL_PIXEL_UNPACK_BUFFER: return 6;
+		case GL_PIXEL_PACK_BUFFER: return 7;
+		default: return -1;
+		}
+	}
+
+	int GLState::getTextureSlot(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_TEXTURE_2D: return 0;
+		case GL_TEXTURE_2D_ARRAY: return 1;
+		case GL_TEXTURE_CUBE_MAP: return 2;
+		case GL_TEXTURE_CUBE_MAP_ARRAY: return 3;
+		default: return -1;
+		}
+	}
+
+	// bindings
+	// ------------------------------------------
+	void GLState::useProgram(GLuint program)
+	{
+		if (update(s_Program, program))
+			glUseProgram(program);
+	}
+
+	void GLState::bindVertexArray(GLuint vertexArray)
+	{
+		if (update(s_VertexArray, vertexArray))
+		{
+			glBindVertexArray(vertexArray);
+			std::unordered_map<GLuint, GLuint>::iterator it = s_ElementBuffers.find(vertexArray);
+			s_ElementBuffer = it != s_ElementBuffers.end() ? it->second : UNKNOWN;
+		}
+	}
+
+	void GLState::bindBuffer(GLenum target, GLuint buffer)
+	{
+		if (target == GL_ELEMENT_ARRAY_BUFFER)
+		{
+			if (update(s_ElementBuffer, buffer))
+			{
+				glBindBuffer(target, buffer);
+				s_ElementBuffers[s_VertexArray] = buffer;
+			}
+			return;
+		}
+		int slot = getBufferSlot(target);
+		if (slot < 0)
+		{
+			s_Stats.issued++;
+			glBindBuffer(target, buffer);
+		}
+		else if (update(s_Buffers[slot], buffer))
+			glBindBuffer(target, buffer);
+	}
+
+	void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		bindBufferRange(target, index, buffer, 0, 0);
+	}
+
+	// size 0 stands for the whole buffer (glBindBufferBase)
+	void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		GLuint* bindings = nullptr;
+		GLintptr* offsets = nullptr;
+		GLsizeiptr* sizes = nullptr;
+		if (target == GL_UNIFORM_BUFFER)
+		{
+			bindings = s_UniformBindings; offsets = s_UniformOffsets; sizes = s_UniformSizes;
+		}
+		else if (target == GL_SHADER_STORAGE_BUFFER)
+		{
+			bindings = s_StorageBindings; offsets = s_StorageOffsets; sizes = s_StorageSizes;
+		}
+
+		if (bindings != nullptr && index < MAX_BUFFER_BINDINGS)
+		{
+			if (bindings[index] == buffer && offsets[index] == offset && sizes[index] == size)
+			{
+				s_Stats.skipped++;
+				return;
+			}
+			bindings[index] = buffer;
+			offsets[index] = offset;
+			sizes[index] = size;
+		}
+		s_Stats.issued++;
+		if (size == 0)
+			glBindBufferBase(target, index, buffer);
+		else
+			glBindBufferRange(target, index, buffer, offset, size);
+		// indexed binds also replace the generic binding point
+		int slot = getBufferSlot(target);
+		if (slot >= 0)
+			s_Buffers[slot] = buffer;
+	}
+
+	void GLState::activeTexture(unsigned int unit)
+	{
+		if (update(s_ActiveTexture, unit))
+			glActiveTexture(GL_TEXTURE0 + unit);
+	}
+
+	void GLState::bindTexture(unsigned int unit, GLenum target, GLuint texture)
+	{
+		int slot = getTextureSlot(target);
+		if (slot < 0 || unit >= MAX_TEXTURE_UNITS)
+		{
+			activeTexture(unit);
+			s_Stats.issued++;
+			glBindTexture(target, texture);
+			return;
+		}
+		if (s_Textures[unit][slot] == texture)
+		{
+			s_Stats.skipped++;
+			return;
+		}
+		activeTexture(unit);
+		s_Textures[unit][slot] = texture;
+		s_Stats.issued++;
+		glBindTexture(target, texture);
+	}
+
+	// fixed function state
+	// ------------------------------------------
+	void GLState::setDepthTest(bool enabled)
+	{
+		updateFlag(s_DepthTest, enabled, GL_DEPTH_TEST);
+	}
+
+	void GLState::setDepthMask(bool enabled)
+	{
+		int flag = enabled ? 1 : 0;
+		if (s_DepthMask == flag)
+		{
+			s_Stats.skipped++;
+			return;
+		}
+		s_DepthMask = flag;
+		s_Stats.issued++;
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	}
+
+	void GLState::setDepthFunc(GLenum func)
+	{
+		if (update(s_DepthFunc, func))
+			glDepthFunc(func);
+	}
+
+	void GLState::setBlend(bool enabled)
+	{
+		updateFlag(s_Blend, enabled, GL_BLEND);
+	}
+
+	void GLState::setBlendFunc(GLenum src, GLenum dst)
+	{
+		if (s_BlendSrc == src && s_BlendDst == dst)
+		{
+			s_Stats.skipped++;
+			return;
+		}
+		s_BlendSrc = src;
+		s_BlendDst = dst;
+		s_Stats.issued++;
+		glBlendFunc(src, dst);
+	}
+
+	void GLState::setCullFace(bool enabled)
+	{
+		updateFlag(s_CullFace, enabled, GL_CULL_FACE);
+	}
+
+	void GLState::setCullMode(GLenum mode)
+	{
+		if (update(s_CullMode, mode))
+			glCullFace(mode);
+	}
+
+	// deletion, GL unbinds deleted objects from the current context itself
+	// ------------------------------------------
+	void GLState::deleteProgram(GLuint program)
+	{
+		glDeleteProgram(program);
+		if (s_Program == program)
+			s_Program = UNKNOWN;
+	}
+
+	void GLState::deleteVertexArray(GLuint vertexArray)
+	{
+		glDeleteVertexArrays(1, &vertexArray);
+		s_ElementBuffers.erase(vertexArray);
+		if (s_VertexArray == vertexArray)
+		{
+			s_VertexArray = 0;
+			s_ElementBuffer = UNKNOWN;
+		}
+	}
+
+	void GLState::deleteBuffer(GLuint buffer)
+	{
+		glDeleteBuffers(1, &buffer);
+		if (s_ElementBuffer == buffer)
+			s_ElementBuffer = 0;
+		for (std::unordered_map<GLuint, GLuint>::iterator it = s_ElementBuffers.begin(); it != s_ElementBuffers.end(); ++it)
+			if (it->second == buffer)
+				it->second = UNKNOWN;
+		for (unsigned int i = 0; i < 8; i++)
+			if (s_Buffers[i] == buffer)
+				s_Buffers[i] = 0;
+		for (unsigned int i = 0; i < MAX_BUFFER_BINDINGS; i++)
+		{
+			// indexed bindings aren't reset by the delete, only the generic ones
+			if (s_UniformBindings[i] == buffer)
+				s_UniformBindings[i] = UNKNOWN;
+			if (s_StorageBindings[i] == buffer)
+				s_StorageBindings[i] = UNKNOWN;
+		}
+	}
+
+	void GLState::deleteTexture(GLuint texture)
+	{
+		glDeleteTextures(1, &texture);
+		for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+			for (unsigned int slot = 0; slot < 4; slot++)
+				if (s_Textures[unit][slot] == texture)
+					s_Textures[unit][slot] = 0;
+	}
+
+	void GLState::invalidate()
+	{
+		s_Program = UNKNOWN;
+		s_VertexArray = UNKNOWN;
+		s_ElementBuffer = UNKNOWN;
+		s_ElementBuffers.clear();
+		for (unsigned int i = 0; i < 8; i++)
+			s_Buffers[i] = UNKNOWN;
+		s_ActiveTexture = UNKNOWN;
+		for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+			for (unsigned int slot = 0; slot < 4; slot++)
+				s_Textures[unit][slot] = UNKNOWN;
+		for (unsigned int i = 0; i < MAX_BUFFER_BINDINGS; i++)
+			s_UniformBindings[i] = s_StorageBindings[i] = UNKNOWN;
+		s_DepthTest = s_Blend = s_CullFace = s_DepthMask = -1;
+		s_DepthFunc = s_BlendSrc = s_BlendDst = s_CullMode = UNKNOWN;
+	}
+
+	// statistics
+	// ------------------------------------------
+	void GLState::endFrame()
+	{
+		s_Stats.frames++;
+	}
+
+	void GLState::printStats()
+	{
+		unsigned long long frames = s_Stats.frames > 0 ? s_Stats.frames : 1;
+		std::cout << "GL state: " << s_Stats.issued / frames << " calls issued, "
+			<< s_Stats.skipped / frames << " redundant calls removed per frame" << std::endl;
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <iostream>
+#include <unordered_map>
+
+// unbind() calls only reach GL in debug builds, where a clean zero binding helps catch
+// code relying on stale state. release builds leave whatever is bound and let GLState
+// skip the rebind.
+#ifdef _DEBUG
+#define GLSTATE_UNBIND 1
+#else
+#define GLSTATE_UNBIND 0
+#endif
+
+namespace graphics {
+
+	struct GLStateStats {
+		unsigned long long issued;		// calls forwarded to GL
+		unsigned long long skipped;		// calls dropped because the state was already set
+		unsigned long long frames;
+	};
+
+	// Thin state tracker between the engine and GL. Every bind/enable goes through here and
+	// is dropped when it would set the state to its current value. Code calling GL directly
+	// has to call invalidate() afterwards.
+	class GLState
+	{
+	public:
+		static const unsigned int MAX_TEXTURE_UNITS = 32;
+		static const unsigned int MAX_BUFFER_BINDINGS = 16;
+
+	private:
+		static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+		static GLuint s_Program;
+		static GLuint s_VertexArray;
+		static GLuint s_ElementBuffer;
+		static GLuint s_Buffers[8];
+		static unsigned int s_ActiveTexture;
+		static GLuint s_Textures[MAX_TEXTURE_UNITS][4];
+		static GLuint s_UniformBindings[MAX_BUFFER_BINDINGS];
+		static GLintptr s_UniformOffsets[MAX_BUFFER_BINDINGS];
+		static GLsizeiptr s_UniformSizes[MAX_BUFFER_BINDINGS];
+		static GLuint s_StorageBindings[MAX_BUFFER_BINDINGS];
+		static GLintptr s_StorageOffsets[MAX_BUFFER_BINDINGS];
+		static GLsizeiptr s_StorageSizes[MAX_BUFFER_BINDINGS];
+		static int s_DepthTest, s_Blend, s_CullFace, s_DepthMask;
+		static GLenum s_DepthFunc, s_BlendSrc, s_BlendDst, s_CullMode;
+		// the element buffer binding is vertex array state, remembered per vertex array
+		static std::unordered_map<GLuint, GLuint> s_ElementBuffers;
+		static GLStateStats s_Stats;
+
+	public:
+		static void useProgram(GLuint program);
+		static void bindVertexArray(GLuint vertexArray);
+		static void bindBuffer(GLenum target, GLuint buffer);
+		static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+		static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+		static void activeTexture(unsigned int unit);
+		static void bindTexture(unsigned int unit, GLenum target, GLuint texture);
+
+		static void setDepthTest(bool enabled);
+		static void setDepthMask(bool enabled);
+		static void setDepthFunc(GLenum func);
+		static void setBlend(bool enabled);
+		static void setBlendFunc(GLenum src, GLenum dst);
+		static void setCullFace(bool enabled);
+		static void setCullMode(GLenum mode);
+
+		// delete the object and forget every binding that still refers to it
+		static void deleteProgram(GLuint program);
+		static void deleteVertexArray(GLuint vertexArray);
+		static void deleteBuffer(GLuint buffer);
+		static void deleteTexture(GLuint texture);
+
+		// forget everything, the next call of each kind reaches GL again
+		static void invalidate();
+
+		inline static GLuint getProgram() { return s_Program; }
+		inline static GLuint getVertexArray() { return s_VertexArray; }
+		inline static unsigned int getActiveTexture() { return s_ActiveTexture; }
+
+		static void endFrame();
+		inline static const GLStateStats& getStats() { return s_Stats; }
+		static void printStats();
+
+	private:
+		static bool update(GLuint &current, GLuint value);
+		static bool updateFlag(int &current, bool value, GLenum cap);
+		static int getBufferSlot(GLenum target);
+		static int getTextureSlot(GLenum target);
+	};
+}
@@ -0,0 +1,174 @@
+#include "clustergrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace graphics {
+
+	ClusterGrid::ClusterGrid(unsigned int maxLights, unsigned int maxIndices)
+		:m_MaxLights(maxLights), m_MaxIndices(maxIndices), m_IndexCount(0), m_MaxClusterLights(0), m_Overflowed(false)
+	{
+		setProjection(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f, 800.0f, 600.0f);
+
+		m_Counts.resize(CLUSTER_COUNT);
+		m_Ranges.resize(CLUSTER_COUNT * 2);
+		m_Indices.reserve(m_MaxIndices);
+
+		// ranges and indices of one frame, each range rounded up to the alignment by the ring
+		unsigned int frameSize = CLUSTER_COUNT * 2 * sizeof(unsigned int) + m_MaxIndices * sizeof(unsigned int);
+		m_Storage = new RingBuffer(GL_SHADER_STORAGE_BUFFER, frameSize + 2 * RingBuffer::getAlignment(GL_SHADER_STORAGE_BUFFER));
+	}
+
+	ClusterGrid::~ClusterGrid()
+	{
+		delete m_Storage;
+	}
+
+	void ClusterGrid::setProjection(float fovY, float aspect, float nearPlane, float farPlane, float width, float height)
+	{
+		m_TanHalfFovY = std::tan(fovY * 0.5f);
+		m_TanHalfFovX = m_TanHalfFovY * aspect;
+		m_Near = nearPlane;
+		m_Far = farPlane;
+		m_Width = width;
+		m_Height = height;
+
+		// exponential slices keep clusters roughly cubic in view space
+		float logRatio = std::log(m_Far / m_Near);
+		m_SliceScale = SLICES / logRatio;
+		m_SliceBias = SLICES * std::log(m_Near) / logRatio;
+	}
+
+	void ClusterGrid::build(const glm::mat4 &view, const PointLightData* lights, unsigned int count, RingBuffer* constants)
+	{
+		m_Storage->beginFrame();
+
+		if (count > m_MaxLights)
+			count = m_MaxLights;
+		m_Bounds.resize(count);
+		m_Visible.resize(count);
+		std::fill(m_Counts.begin(), m_Counts.end(), 0);
+
+		// pass 1: cluster range of every light and the number of lights per cluster
+		for (unsigned int i = 0; i < count; i++)
+		{
+			glm::vec3 center = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+			m_Visible[i] = computeBounds(center, lights[i].radius, m_Bounds[i]);
+			if (!m_Visible[i])
+				continue;
+			const LightBounds &b = m_Bounds[i];
+			for (unsigned int z = b.z0; z <= b.z1; z++)
+				for (unsigned int y = b.y0; y <= b.y1; y++)
+					for (unsigned int x = b.x0; x <= b.x1; x++)
+						m_Counts[x + TILES_X * (y + TILES_Y * z)]++;
+		}
+
+		// prefix sum into (offset, count) ranges, truncating the lists once the index budget is spent
+		unsigned int offset = 0;
+		m_MaxClusterLights = 0;
+		bool overflowed = false;
+		for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+		{
+			unsigned int clusterCount = std::min(m_Counts[c], m_MaxIndices - offset);
+			overflowed |= clusterCount < m_Counts[c];
+			m_Ranges[c * 2 + 0] = offset;
+			m_Ranges[c * 2 + 1] = clusterCount;
+			m_MaxClusterLights = std::max(m_MaxClusterLights, clusterCount);
+			offset += clusterCount;
+			m_Counts[c] = 0;
+		}
+		m_IndexCount = offset;
+		if (overflowed && !m_Overflowed)
+			std::cout << "ERROR::CLUSTERGRID::INDEX_OVERFLOW more than " << m_MaxIndices << " light references, cluster lists truncated" << std::endl;
+		m_Overflowed = overflowed;
+
+		// pass 2: scatter the light indices, m_Counts now serves as the fill cursor
+		m_Indices.resize(m_IndexCount);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (!m_Visible[i])
+				continue;
+			const LightBounds &b = m_Bounds[i];
+			for (unsigned int z = b.z0; z <= b.z1; z++)
+				for (unsigned int y = b.y0; y <= b.y1; y++)
+					for (unsigned int x = b.x0; x <= b.x1; x++)
+					{
+						unsigned int c = x + TILES_X * (y + TILES_Y * z);
+						if (m_Counts[c] < m_Ranges[c * 2 + 1])
+							m_Indices[m_Ranges[c * 2] + m_Counts[c]++] = i;
+					}
+		}
+
+		// upload, every list is bound as a range of this frame's storage. An empty index list
+		// still gets one element, zero sized ranges can't be bound
+		unsigned int rangesSize = CLUSTER_COUNT * 2 * sizeof(unsigned int);
+		unsigned int indicesSize = std::max(m_IndexCount, 1u) * sizeof(unsigned int);
+		unsigned int rangesOffset, indicesOffset;
+		void* rangesMemory = m_Storage->allocate(rangesSize, rangesOffset);
+		void* indicesMemory = m_Storage->allocate(indicesSize, indicesOffset);
+		if (rangesMemory == nullptr || indicesMemory == nullptr)
+			return;
+		std::memcpy(rangesMemory, &m_Ranges[0], rangesSize);
+		if (m_IndexCount > 0)
+			std::memcpy(indicesMemory, &m_Indices[0], m_IndexCount * sizeof(unsigned int));
+		m_Storage->bindRange(CLUSTER_RANGE_STORAGE_BINDING, rangesOffset, rangesSize);
+		m_Storage->bindRange(CLUSTER_INDEX_STORAGE_BINDING, indicesOffset, indicesSize);
+
+		ClusterBlock block;
+		block.clusterGrid = glm::uvec4(TILES_X, TILES_Y, SLICES, count);
+		block.clusterParams = glm::vec4(m_Width / TILES_X, m_Height / TILES_Y, m_SliceScale, m_SliceBias);
+		int blockOffset = constants->push(&block, sizeof(ClusterBlock));
+		if (blockOffset >= 0)
+			constants->bindRange(CLUSTER_BLOCK_BINDING, blockOffset, sizeof(ClusterBlock));
+	}
+
+	void ClusterGrid::endFrame()
+	{
+		m_Storage->endFrame();
+	}
+
+	bool ClusterGrid::computeBounds(const glm::vec3 &center, float radius, LightBounds &bounds) const
+	{
+		float depth = -center.z;
+		if (radius <= 0.0f || depth + radius < m_Near || depth - radius > m_Far)
+			return false;
+		float zNear = std::max(depth - radius, m_Near);
+		float zFar = std::min(depth + radius, m_Far);
+
+		// screen rectangle of the sphere's view-space box. x / z is monotonic in z, so the
+		// extremes are found at the near and far end of the box's depth range
+		float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+		float depths[2] = { zNear, zFar };
+		for (int i = 0; i < 2; i++)
+		{
+			float invX = 1.0f / (depths[i] * m_TanHalfFovX);
+			float invY = 1.0f / (depths[i] * m_TanHalfFovY);
+			minX = std::min(minX, (center.x - radius) * invX);
+			maxX = std::max(maxX, (center.x + radius) * invX);
+			minY = std::min(minY, (center.y - radius) * invY);
+			maxY = std::max(maxY, (center.y + radius) * invY);
+		}
+		if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+			return false;
+
+		// NDC to tiles, y grows upwards like gl_FragCoord
+		minX = std::max(minX, -1.0f); maxX = std::min(maxX, 1.0f);
+		minY = std::max(minY, -1.0f); maxY = std::min(maxY, 1.0f);
+		bounds.x0 = (unsigned short)std::min((unsigned int)((minX * 0.5f + 0.5f) * TILES_X), TILES_X - 1);
+		bounds.x1 = (unsigned short)std::min((unsigned int)((maxX * 0.5f + 0.5f) * TILES_X), TILES_X - 1);
+		bounds.y0 = (unsigned short)std::min((unsigned int)((minY * 0.5f + 0.5f) * TILES_Y), TILES_Y - 1);
+		bounds.y1 = (unsigned short)std::min((unsigned int)((maxY * 0.5f + 0.5f) * TILES_Y), TILES_Y - 1);
+		bounds.z0 = (unsigned short)depthSlice(zNear);
+		bounds.z1 = (unsigned short)depthSlice(zFar);
+		return true;
+	}
+
+	unsigned int ClusterGrid::depthSlice(float depth) const
+	{
+		float slice = std::floor(std::log(depth) * m_SliceScale - m_SliceBias);
+		if (slice < 0.0f)
+			return 0;
+		return std::min((unsigned int)slice, SLICES - 1);
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <vector>
+
+#include "../uniformblocks.h"
+#include "../buffers/ringbuffer.h"
+
+namespace graphics {
+
+	// Clustered light assignment for the USE_CLUSTERED_LIGHTS permutation of model.fs.
+	// The view frustum is split into TILES_X * TILES_Y screen tiles and SLICES exponential depth
+	// slices. Every frame each point light's bounding sphere is assigned to the clusters it
+	// touches on the CPU, and the per-cluster (offset, count) ranges and the flat light index
+	// list are streamed into two shader storage buffers. The indices refer to the light list
+	// the LightManager uploads. A fragment then only shades the lights of its own cluster.
+	class ClusterGrid
+	{
+	public:
+		static const unsigned int TILES_X = 16;
+		static const unsigned int TILES_Y = 9;
+		static const unsigned int SLICES = 24;
+		static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+	private:
+		// projection the grid is built for
+		float m_TanHalfFovX, m_TanHalfFovY;
+		float m_Near, m_Far;
+		float m_Width, m_Height;
+		// slice = log(depth) * scale - bias
+		float m_SliceScale, m_SliceBias;
+
+		unsigned int m_MaxLights;
+		unsigned int m_MaxIndices;
+
+		// cluster range of every light, filled by the counting pass and reused by the fill pass
+		struct LightBounds {
+			unsigned short x0, x1, y0, y1, z0, z1;
+		};
+		std::vector<LightBounds> m_Bounds;
+		std::vector<unsigned char> m_Visible;
+		std::vector<unsigned int> m_Counts;
+		// (offset, count) per cluster and the index lists, built on the CPU and copied to the
+		// mapped storage in one go since the mapping is write-combined
+		std::vector<unsigned int> m_Ranges;
+		std::vector<unsigned int> m_Indices;
+
+		// shader storage for ranges and indices, three frames in flight
+		RingBuffer* m_Storage;
+
+		// stats of the last build
+		unsigned int m_IndexCount;
+		unsigned int m_MaxClusterLights;
+		bool m_Overflowed;
+
+	public:
+		// lights beyond maxLights are ignored and cluster lists are truncated once maxIndices is reached
+		ClusterGrid(unsigned int maxLights, unsigned int maxIndices);
+		~ClusterGrid();
+
+		// perspective the scene is rendered with, sizes in pixels
+		void setProjection(float fovY, float aspect, float nearPlane, float farPlane, float width, float height);
+
+		// assigns the lights to clusters, uploads the lists and binds the storage buffers. lights has
+		// to be the list bound at POINT_LIGHT_STORAGE_BINDING. The cluster parameters are written
+		// into constants and bound at CLUSTER_BLOCK_BINDING
+		void build(const glm::mat4 &view, const PointLightData* lights, unsigned int count, RingBuffer* constants);
+
+		// fences this frame's storage, call once the frame's draws have been issued
+		void endFrame();
+
+		inline unsigned int getIndexCount() const { return m_IndexCount; }
+		inline unsigned int getMaxClusterLights() const { return m_MaxClusterLights; }
+
+	private:
+		// cluster ranges of a view-space sphere, false if it lies outside the frustum
+		bool computeBounds(const glm::vec3 &center, float radius, LightBounds &bounds) const;
+		unsigned int depthSlice(float depth) const;
+	};
+}
@@ -0,0 +1,166 @@
+#include "lightmanager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// four lights per test on any x86 target, scalar loop elsewhere
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define LIGHTMANAGER_SSE 1
+#include <xmmintrin.h>
+#else
+#define LIGHTMANAGER_SSE 0
+#endif
+
+namespace graphics {
+
+	LightManager::LightManager(unsigned int maxLights)
+		:m_Count(0), m_MaxLights(maxLights)
+	{
+		m_Lights.reserve(m_MaxLights);
+		m_Visible.reserve(m_MaxLights);
+		m_VisibleIndices.reserve(m_MaxLights);
+		m_Storage = new RingBuffer(GL_SHADER_STORAGE_BUFFER, m_MaxLights * sizeof(PointLightData));
+	}
+
+	LightManager::~LightManager()
+	{
+		delete m_Storage;
+	}
+
+	int LightManager::addPointLight(const glm::vec3 &position, const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular,
+		float constant, float linear, float quadratic)
+	{
+		if (m_Count >= m_MaxLights)
+		{
+			std::cout << "ERROR::LIGHTMANAGER::TOO_MANY_LIGHTS limit is " << m_MaxLights << std::endl;
+			return -1;
+		}
+
+		// grow the hot arrays a group of four at a time, padding lights can never pass the cull
+		if (m_Count % 4 == 0)
+		{
+			m_PositionX.resize(m_Count + 4, 0.0f);
+			m_PositionY.resize(m_Count + 4, 0.0f);
+			m_PositionZ.resize(m_Count + 4, 0.0f);
+			m_Radius.resize(m_Count + 4, -1e30f);
+		}
+
+		PointLightData light;
+		light.position = position;
+		light.ambient = ambient;
+		light.diffuse = diffuse;
+		light.specular = specular;
+		light.constant = constant;
+		light.linear = linear;
+		light.quadratic = quadratic;
+		float intensity = std::max(std::max(diffuse.r, diffuse.g), diffuse.b);
+		intensity = std::max(intensity, std::max(std::max(specular.r, specular.g), specular.b));
+		light.radius = computeRadius(intensity, constant, linear, quadratic);
+		light.shadowIndex = -1;
+		light.padding[0] = light.padding[1] = light.padding[2] = 0;
+		m_Lights.push_back(light);
+
+		m_PositionX[m_Count] = position.x;
+		m_PositionY[m_Count] = position.y;
+		m_PositionZ[m_Count] = position.z;
+		// lights too dim to ever be seen never pass the cull
+		m_Radius[m_Count] = light.radius > 0.0f ? light.radius : -1e30f;
+		return m_Count++;
+	}
+
+	void LightManager::setPosition(unsigned int index, const glm::vec3 &position)
+	{
+		m_PositionX[index] = position.x;
+		m_PositionY[index] = position.y;
+		m_PositionZ[index] = position.z;
+	}
+
+	glm::vec3 LightManager::getPosition(unsigned int index) const
+	{
+		return glm::vec3(m_PositionX[index], m_PositionY[index], m_PositionZ[index]);
+	}
+
+	void LightManager::cull(const Frustum &frustum)
+	{
+		m_VisibleIndices.clear();
+		unsigned int padded = (m_Count + 3) & ~3u;
+
+#if LIGHTMANAGER_SSE
+		// plane coefficients broadcast once, then every plane is tested against four spheres
+		__m128 planes[Frustum::PLANE_COUNT][4];
+		for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+			for (int c = 0; c < 4; c++)
+				planes[p][c] = _mm_set1_ps(frustum.getPlane(p)[c]);
+
+		for (unsigned int i = 0; i < padded; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&m_PositionX[i]);
+			__m128 y = _mm_loadu_ps(&m_PositionY[i]);
+			__m128 z = _mm_loadu_ps(&m_PositionZ[i]);
+			__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_Radius[i]));
+
+			__m128 inside = _mm_cmpeq_ps(negRadius, negRadius);
+			for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+					_mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+			}
+
+			int mask = _mm_movemask_ps(inside);
+			for (unsigned int lane = 0; lane < 4; lane++)
+				if (mask & (1 << lane))
+					m_VisibleIndices.push_back(i + lane);
+		}
+#else
+		for (unsigned int i = 0; i < m_Count; i++)
+			if (frustum.intersectsSphere(glm::vec3(m_PositionX[i], m_PositionY[i], m_PositionZ[i]), m_Radius[i]))
+				m_VisibleIndices.push_back(i);
+#endif
+
+		// pack the survivors in the layout the shaders read
+		m_Visible.resize(m_VisibleIndices.size());
+		for (unsigned int i = 0; i < m_VisibleIndices.size(); i++)
+		{
+			unsigned int index = m_VisibleIndices[i];
+			m_Visible[i] = m_Lights[index];
+			m_Visible[i].position = glm::vec3(m_PositionX[index], m_PositionY[index], m_PositionZ[index]);
+		}
+	}
+
+	void LightManager::upload()
+	{
+		m_Storage->beginFrame();
+
+		// an empty list still binds one element, zero sized ranges can't be bound
+		unsigned int count = getVisibleCount();
+		unsigned int size = std::max(count, 1u) * sizeof(PointLightData);
+		unsigned int offset;
+		void* memory = m_Storage->allocate(size, offset);
+		if (memory == nullptr)
+			return;
+		if (count > 0)
+			std::memcpy(memory, &m_Visible[0], count * sizeof(PointLightData));
+		m_Storage->bindRange(POINT_LIGHT_STORAGE_BINDING, offset, size);
+	}
+
+	void LightManager::endFrame()
+	{
+		m_Storage->endFrame();
+	}
+
+	float LightManager::computeRadius(float intensity, float constant, float linear, float quadratic)
+	{
+		// solve intensity / (constant + linear * d + quadratic * d^2) = 5 / 256 for d
+		float c = constant - intensity * (256.0f / 5.0f);
+		if (c >= 0.0f)
+			return 0.0f;
+		if (quadratic > 0.0f)
+			return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+		if (linear > 0.0f)
+			return -c / linear;
+		// no falloff at all, reaches everything
+		return 1e30f;
+	}
+}
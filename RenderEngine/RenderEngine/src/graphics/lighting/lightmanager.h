@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <vector>
+
+#include "../frustum.h"
+#include "../uniformblocks.h"
+#include "../buffers/ringbuffer.h"
+
+namespace graphics {
+
+	// Owns the scene's point lights. Positions and radii, the only data culling touches, live in
+	// separate arrays padded to a multiple of four so the frustum test runs on four lights per
+	// SSE instruction; the rest of each light is kept in its GPU layout. Every frame the lights
+	// intersecting the camera frustum are packed and streamed into the shader storage buffer at
+	// POINT_LIGHT_STORAGE_BINDING, which model.fs, the cluster grid and the deferred volume pass
+	// all read. Off-screen lights cost nothing on the GPU.
+	class LightManager
+	{
+	private:
+		// hot data, structure of arrays
+		std::vector<float> m_PositionX, m_PositionY, m_PositionZ, m_Radius;
+		// cold data, position and radius are filled in when packing
+		std::vector<PointLightData> m_Lights;
+		unsigned int m_Count;
+
+		// survivors of the last cull, in GPU layout
+		std::vector<unsigned int> m_VisibleIndices;
+		std::vector<PointLightData> m_Visible;
+
+		RingBuffer* m_Storage;
+		unsigned int m_MaxLights;
+
+	public:
+		LightManager(unsigned int maxLights);
+		~LightManager();
+
+		// returns the light's index, or -1 when maxLights is reached. The radius is derived from
+		// the attenuation, see computeRadius
+		int addPointLight(const glm::vec3 &position, const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular,
+			float constant, float linear, float quadratic);
+		void setPosition(unsigned int index, const glm::vec3 &position);
+		glm::vec3 getPosition(unsigned int index) const;
+		inline float getRadius(unsigned int index) const { return m_Radius[index]; }
+		inline const glm::vec3 &getDiffuse(unsigned int index) const { return m_Lights[index].diffuse; }
+		inline unsigned int getCount() const { return m_Count; }
+		// layer of the PointShadowMap the light samples, -1 for none
+		inline void setShadowIndex(unsigned int index, int shadowIndex) { m_Lights[index].shadowIndex = shadowIndex; }
+
+		// keeps the lights whose sphere touches the frustum, in the space the frustum was built in
+		void cull(const Frustum &frustum);
+		// streams the visible lights to the GPU and binds them, call after cull
+		void upload();
+		// fences this frame's storage, call once the frame's draws have been issued
+		void endFrame();
+
+		inline const PointLightData* getVisibleLights() const { return m_Visible.empty() ? nullptr : &m_Visible[0]; }
+		inline unsigned int getVisibleCount() const { return (unsigned int)m_Visible.size(); }
+
+		// distance at which the brightest channel drops below 5/256 of full intensity
+		static float computeRadius(float intensity, float constant, float linear, float quadratic);
+	};
+}
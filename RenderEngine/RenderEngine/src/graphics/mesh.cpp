@@ -1,122 +1,128 @@
 #include "mesh.h"
+#include "glstate.h"
 
 namespace graphics {
 
 	// constructor
-	Mesh::Mesh(vector<VertexData> vertices, vector<unsigned int> indices, vector<TextureData> textures)
-		:m_Vertices(vertices), m_Indices(indices),m_Textures(textures)
+	Mesh::Mesh(vector<VertexData> vertices, vector<unsigned int> indices, vector<TextureData> textures, float shininess, GeometryPool* pool, TexturePool* texturePool)
+		:m_Vertices(vertices), m_Indices(indices),m_Textures(textures), m_Pool(pool)
 	{
-		// set the vertex buffers and its attribute pointers.
+		// place the vertices and indices in the shared buffers
 		setupMesh();
+		setupMaterial(shininess, texturePool);
 	}
 
 	// render the mesh
-	void Mesh::Draw(Shader * shader)
+	void Mesh::Draw(unsigned int instanceCount, unsigned int drawID)
 	{
 		// bind buffers/arrays
-		// bind vertex array
-		glBindVertexArray(m_VAO);
-		// bind element buffers
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-		// bind appropriate textures
-		unsigned int diffuseNr = 1;
-		unsigned int specularNr = 1;
-		unsigned int normalNr = 1;
-		unsigned int heightNr = 1;
-		for (unsigned int i = 0; i < m_Textures.size(); i++)
-		{
-			// active proper texture unit before binding
-			glActiveTexture(GL_TEXTURE0 + i); 
-			// retrieve texture number (the N in diffuse_textureN)
-			stringstream ss;
-			string number;
-			string material = "material.";
-			string name = m_Textures[i].type;
-			if (name == "texture_diffuse")
-				ss << diffuseNr++; // transfer unsigned int to stream
-			else if (name == "texture_specular")
-				ss << specularNr++; // transfer unsigned int to stream
-			else if (name == "texture_normal")
-				ss << normalNr++; // transfer unsigned int to stream
-			else if (name == "texture_height")
-				ss << heightNr++; // transfer unsigned int to stream
-			number = ss.str();
-			// set the uniform sampler in the shader to the correct texture unit
-			glUniform1i(glGetUniformLocation(shader->getShaderID(), (material + name + number).c_str()), i);
-			// bind proper texture unit
-			glBindTexture(GL_TEXTURE_2D, m_Textures[i].id);
-		}
+		bindMaterial();
+		bindGeometry();
 
 		// draw mesh
-		glDrawElements(GL_TRIANGLES, m_Indices.size(), GL_UNSIGNED_INT, 0);
+		drawElements(instanceCount, drawID);
 
-		
+#if GLSTATE_UNBIND
 		// unbind buffers/arrays/textures
 		// unbind textures
-		for (unsigned int i = 0; i < m_Textures.size(); i++)
-		{
-			// active proper texture unit before unbinding
-			glActiveTexture(GL_TEXTURE0 + i); 
-			// unbind proper texture unit
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
-		// unbind element buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		// unbind vertex array
-		glBindVertexArray(0);
-		
+		for (unsigned int i = 0; i < m_BindingCount; i++)
+			GLState::bindTexture(m_Bindings[i].unit, m_Bindings[i].target, 0);
+		// unbind vertex array, the element buffer stays attached to it
+		GLState::bindVertexArray(0);
+#endif
+	}
+
+	void Mesh::bindMaterial() const
+	{
+		// the layers and constants come from the Materials block, only the arrays are bound
+		for (unsigned int i = 0; i < m_BindingCount; i++)
+			GLState::bindTexture(m_Bindings[i].unit, m_Bindings[i].target, m_Bindings[i].texture);
+	}
+
+	void Mesh::bindGeometry() const
+	{
+		// bind the pool's vertex array, shared by every mesh in it
+		GLState::bindVertexArray(m_Pool->getVertexArray());
+		// bind element buffers, already part of the vertex array so normally skipped by GLState
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Pool->getIndexBuffer());
+		m_Pool->bindMeshes();
+	}
+
+	void Mesh::drawElements(unsigned int instanceCount, unsigned int drawID) const
+	{
+		// the base instance only selects the draw record, see GeometryPool
+		m_Pool->reserveDraws(drawID + 1);
+		glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, m_Indices.size(), m_IndexType,
+			(void*)(size_t)(m_FirstIndex * IndexBuffer::getIndexSize(m_IndexType)), instanceCount, m_BaseVertex, drawID);
 	}
 
-	// initializes all the buffer objects/arrays
+	void Mesh::DrawDepth(unsigned int instanceCount, unsigned int drawID)
+	{
+		m_Pool->reserveDraws(drawID + 1);
+		GLState::bindVertexArray(m_Pool->getDepthVertexArray());
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Pool->getIndexBuffer());
+		m_Pool->bindMeshes();
+		glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, m_Indices.size(), m_IndexType,
+			(void*)(size_t)(m_FirstIndex * IndexBuffer::getIndexSize(m_IndexType)), instanceCount, m_BaseVertex, drawID);
+#if GLSTATE_UNBIND
+		GLState::bindVertexArray(0);
+#endif
+	}
+
+	// the permutation of model.fs matching this mesh's textures, no fetches for maps it doesn't have
+	void Mesh::getMaterialDefines(ShaderDefines &defines) const
+	{
+		defines.set("HAS_DIFFUSE_MAP", m_Slabs[DIFFUSE_MAP_UNIT] != 0 ? 1 : 0);
+		defines.set("HAS_SPECULAR_MAP", m_Slabs[SPECULAR_MAP_UNIT] != 0 ? 1 : 0);
+		defines.set("HAS_NORMAL_MAP", m_Slabs[NORMAL_MAP_UNIT] != 0 ? 1 : 0);
+		defines.set("COMPACT_VERTICES", m_Pool->getFormat() == COMPACT_VERTICES ? 1 : 0);
+	}
+
+	// copies the vertices and indices into the pool
 	void Mesh::setupMesh()
 	{
-		// create buffers/arrays
-		// create vertex array
-		glGenVertexArrays(1, &m_VAO);
-		// create element buffer
-		glGenBuffers(1, &m_EBO);
-		// create vertex buffer
-		glGenBuffers(1, &m_VBO);
+		m_MeshIndex = m_Pool->allocate(&m_Vertices[0], (unsigned int)m_Vertices.size(), &m_Indices[0], (unsigned int)m_Indices.size(),
+			m_BaseVertex, m_FirstIndex, m_IndexType);
+	}
 
-		// bind buffers/arrays
-		// bind vertex array
-		glBindVertexArray(m_VAO);
-		// bind element buffers
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-		// bind vertex buffers
-		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-		
-		// load data in buffer
-		// load indices in  element buffer
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(unsigned int), &m_Indices[0], GL_STATIC_DRAW);
-		// load vertices in  array buffer
-		glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(VertexData), &m_Vertices[0], GL_STATIC_DRAW);
+	void Mesh::setupMaterial(float shininess, TexturePool* texturePool)
+	{
+		int layers[MATERIAL_MAP_COUNT] = { -1, -1, -1 };
+		for (unsigned int i = 0; i < MATERIAL_MAP_COUNT; i++)
+			m_Slabs[i] = 0;
+		for (unsigned int i = 0; i < m_Textures.size(); i++)
+		{
+			int unit = -1;
+			if (m_Textures[i].type == "texture_diffuse")
+				unit = DIFFUSE_MAP_UNIT;
+			else if (m_Textures[i].type == "texture_specular")
+				unit = SPECULAR_MAP_UNIT;
+			else if (m_Textures[i].type == "texture_normal")
+				unit = NORMAL_MAP_UNIT;
+			// maps that failed to load count as missing
+			if (unit < 0 || m_Slabs[unit] != 0 || m_Textures[i].location.slab < 0)
+				continue;
+			m_Slabs[unit] = texturePool->getSlabTexture(m_Textures[i].location.slab);
+			layers[unit] = m_Textures[i].location.layer;
+		}
 
-		// enable and set the vertex attribute pointers
-		// vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)0);
-		// vertex normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Normal));
-		// vertex texture coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, TexCoords));
-		// vertex tangent
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Tangent));
-		// vertex bitangent
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Bitangent));
+		// units of maps the mesh doesn't have aren't sampled by its permutation
+		m_BindingCount = 0;
+		for (unsigned int i = 0; i < MATERIAL_MAP_COUNT; i++)
+		{
+			if (m_Slabs[i] == 0)
+				continue;
+			TextureBinding &binding = m_Bindings[m_BindingCount++];
+			binding.unit = i;
+			binding.target = GL_TEXTURE_2D_ARRAY;
+			binding.texture = m_Slabs[i];
+		}
 
-		
-		// unbind buffers/arrays
-		// unbind vertex buffers
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		// unbind element buffers
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		// unbind vertex array
-		glBindVertexArray(0);
-		
+		MaterialData material;
+		material.diffuseLayer = layers[DIFFUSE_MAP_UNIT];
+		material.specularLayer = layers[SPECULAR_MAP_UNIT];
+		material.normalLayer = layers[NORMAL_MAP_UNIT];
+		material.shininess = shininess;
+		m_Material = texturePool->addMaterial(material);
 	}
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "texturepool.h"
+#include "buffers/geometrypool.h"
 
 #include <string>
 #include <fstream>
@@ -32,8 +34,15 @@ namespace graphics {
 		glm::vec3 Bitangent;
 	};
 
+	// one texture bind of a mesh's material
+	struct TextureBinding {
+		unsigned int unit;
+		GLenum target;
+		unsigned int texture;
+	};
+
 	struct TextureData {
-		unsigned int id;
+		TextureLocation location;
 		string type;
 		aiString path;
 	};
@@ -44,23 +53,60 @@ namespace graphics {
 		vector<VertexData> m_Vertices;
 		vector<unsigned int> m_Indices;
 		vector<TextureData> m_Textures;
-		unsigned int m_VAO;
 
 	public:
 		/*  Functions  */
-		// constructor
-		Mesh(vector<VertexData> vertices, vector<unsigned int> indices, vector<TextureData> textures);
+		// constructor, the geometry is copied into pool and the material goes to texturePool
+		Mesh(vector<VertexData> vertices, vector<unsigned int> indices, vector<TextureData> textures, float shininess, GeometryPool* pool, TexturePool* texturePool);
+
+		// render the mesh with the bound program, instanceCount copies. drawID is the record of
+		// the bound Draws block that holds the first instance and the material
+		void Draw(unsigned int instanceCount = 1, unsigned int drawID = 0);
+
+		// positions only, for depth passes with their program already bound
+		void DrawDepth(unsigned int instanceCount = 1, unsigned int drawID = 0);
+
+		// the steps of Draw, for callers that skip the ones whose state is already set.
+		// bindMaterial binds the slabs of the mesh's maps, every mesh with the same slabs shares it
+		void bindMaterial() const;
+		void bindGeometry() const;
+		void drawElements(unsigned int instanceCount, unsigned int drawID = 0) const;
+
+		inline GeometryPool* getPool() const { return m_Pool; }
+		// index into the Materials block, and the array texture bound at each MaterialUnit
+		inline unsigned int getMaterial() const { return m_Material; }
+		inline unsigned int getSlab(unsigned int unit) const { return m_Slabs[unit]; }
+		inline unsigned int getVertexArray() const { return m_Pool->getVertexArray(); }
+		// range in the pool, as needed for indirect draw commands
+		inline unsigned int getIndexCount() const { return (unsigned int)m_Indices.size(); }
+		inline unsigned int getFirstIndex() const { return m_FirstIndex; }
+		inline unsigned int getBaseVertex() const { return m_BaseVertex; }
+		// width the pool stored the indices with, firstIndex counts in it
+		inline GLenum getIndexType() const { return m_IndexType; }
+		// record of the mesh in the pool's Meshes block
+		inline unsigned int getMeshIndex() const { return m_MeshIndex; }
 
-		// render the mesh
-		void Draw(Shader* shader);
+		// adds the HAS_*_MAP defines describing which textures this mesh samples, and
+		// COMPACT_VERTICES for the vertex format of its pool
+		void getMaterialDefines(ShaderDefines &defines) const;
 
 	private:
 		/*  Render data  */
-		unsigned int m_VBO, m_EBO;
+		GeometryPool* m_Pool;
+		unsigned int m_BaseVertex, m_FirstIndex, m_MeshIndex;
+		GLenum m_IndexType;
+		unsigned int m_Material;
+		unsigned int m_Slabs[MATERIAL_MAP_COUNT];
+		// the binds of bindMaterial, built once with the material. The units are the fixed
+		// bindings of the samplers, so the table holds for every program
+		TextureBinding m_Bindings[MATERIAL_MAP_COUNT];
+		unsigned int m_BindingCount;
 	private:
 		/*  Functions    */
-		// initializes all the buffer objects/arrays
+		// copies the vertices and indices into the pool
 		void setupMesh();
+		// registers the material with the pool, the first map of each kind is used
+		void setupMaterial(float shininess, TexturePool* texturePool);
 		
 	};
 }
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "meshoptimizer.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace graphics {
+
+	// cache positions the vertex score rewards, larger than CACHE_SIZE so the order doesn't
+	// depend on the exact size of the hardware's cache
+	static const unsigned int SCORE_CACHE_SIZE = 32;
+
+	// FIFO cache hit test, time counts the insertions so far
+	static inline bool fetchVertex(std::vector<unsigned int> &cacheTimes, unsigned int &time, unsigned int vertex)
+	{
+		if (time - cacheTimes[vertex] <= MeshOptimizer::CACHE_SIZE)
+			return true;
+		cacheTimes[vertex] = time++;
+		return false;
+	}
+
+	void MeshOptimizer::optimize(std::vector<VertexData> &vertices, std::vector<unsigned int> &indices, VertexCacheStats* before, VertexCacheStats* after)
+	{
+		if (before != nullptr)
+			*before = analyzeVertexCache(indices, (unsigned int)vertices.size());
+
+		optimizeVertexCache(indices, (unsigned int)vertices.size());
+		optimizeOverdraw(indices, vertices);
+		optimizeVertexFetch(vertices, indices);
+
+		if (after != nullptr)
+			*after = analyzeVertexCache(indices, (unsigned int)vertices.size());
+	}
+
+	void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount)
+	{
+		unsigned int triangleCount = (unsigned int)indices.size() / 3;
+		if (triangleCount < 2)
+			return;
+
+		// the triangles of every vertex, the first remaining[v] of them aren't emitted yet
+		std::vector<unsigned int> remaining(vertexCount, 0), offsets(vertexCount + 1, 0);
+		for (unsigned int i = 0; i < triangleCount * 3; i++)
+			remaining[indices[i]]++;
+		for (unsigned int v = 0; v < vertexCount; v++)
+			offsets[v + 1] = offsets[v] + remaining[v];
+		std::vector<unsigned int> adjacency(triangleCount * 3), fill(offsets.begin(), offsets.end() - 1);
+		for (unsigned int i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[indices[i]]++] = i / 3;
+
+		std::vector<int> cachePositions(vertexCount, -1);
+		std::vector<float> scores(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++)
+			scores[v] = getVertexScore(-1, remaining[v]);
+
+		// the first triangle is the best of all, every later one the best around the cache
+		int best = 0;
+		float bestScore = -1.0f;
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+			if (score > bestScore)
+			{
+				bestScore = score;
+				best = (int)t;
+			}
+		}
+
+		std::vector<unsigned int> result, cache, nextCache;
+		std::vector<bool> emitted(triangleCount, false);
+		result.reserve(triangleCount * 3);
+		unsigned int cursor = 0;
+		for (unsigned int n = 0; n < triangleCount; n++)
+		{
+			// nothing left around the cache, take the next triangle in the old order
+			if (best < 0)
+			{
+				while (emitted[cursor])
+					cursor++;
+				best = (int)cursor;
+			}
+			unsigned int triangle[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+			emitted[best] = true;
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				result.push_back(triangle[k]);
+				// the triangle leaves the ones its vertices still wait for
+				unsigned int v = triangle[k];
+				unsigned int* triangles = &adjacency[offsets[v]];
+				for (unsigned int i = 0; i < remaining[v]; i++)
+					if (triangles[i] == (unsigned int)best)
+					{
+						triangles[i] = triangles[--remaining[v]];
+						break;
+					}
+			}
+
+			// the triangle's vertices move to the front, the rest of the cache shifts back
+			nextCache.clear();
+			for (unsigned int k = 0; k < 3; k++)
+				if (std::find(nextCache.begin(), nextCache.end(), triangle[k]) == nextCache.end())
+					nextCache.push_back(triangle[k]);
+			for (unsigned int i = 0; i < cache.size(); i++)
+				if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+					nextCache.push_back(cache[i]);
+
+			// vertices past the end drop out of the cache but still need their score lowered
+			for (unsigned int i = 0; i < nextCache.size(); i++)
+			{
+				unsigned int v = nextCache[i];
+				cachePositions[v] = i < SCORE_CACHE_SIZE ? (int)i : -1;
+				scores[v] = getVertexScore(cachePositions[v], remaining[v]);
+			}
+
+			// only the triangles of these vertices changed their score
+			best = -1;
+			bestScore = -1.0f;
+			for (unsigned int i = 0; i < nextCache.size(); i++)
+			{
+				unsigned int v = nextCache[i];
+				for (unsigned int j = 0; j < remaining[v]; j++)
+				{
+					unsigned int t = adjacency[offsets[v] + j];
+					float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+					if (score > bestScore)
+					{
+						bestScore = score;
+						best = (int)t;
+					}
+				}
+			}
+			if (nextCache.size() > SCORE_CACHE_SIZE)
+				nextCache.resize(SCORE_CACHE_SIZE);
+			cache.swap(nextCache);
+		}
+		indices.swap(result);
+	}
+
+	void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<VertexData> &vertices)
+	{
+		unsigned int triangleCount = (unsigned int)indices.size() / 3;
+		if (triangleCount < 2)
+			return;
+
+		// a cluster starts at every triangle that misses the cache with all three vertices. The
+		// cache is cold there in any order, so moving the clusters around costs about nothing
+		std::vector<unsigned int> clusters;
+		std::vector<unsigned int> cacheTimes(vertices.size(), 0);
+		unsigned int time = CACHE_SIZE + 1;
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			unsigned int misses = 0;
+			for (unsigned int k = 0; k < 3; k++)
+				if (!fetchVertex(cacheTimes, time, indices[t * 3 + k]))
+					misses++;
+			if (t == 0 || misses == 3)
+				clusters.push_back(t);
+		}
+		unsigned int clusterCount = (unsigned int)clusters.size();
+		if (clusterCount < 2)
+			return;
+		clusters.push_back(triangleCount);
+
+		// area weighted centers and normals of the clusters and the whole mesh
+		std::vector<glm::vec3> centers(clusterCount, glm::vec3(0.0f)), normals(clusterCount, glm::vec3(0.0f));
+		glm::vec3 meshCenter(0.0f);
+		float meshArea = 0.0f;
+		for (unsigned int c = 0; c < clusterCount; c++)
+		{
+			float area = 0.0f;
+			for (unsigned int t = clusters[c]; t < clusters[c + 1]; t++)
+			{
+				const glm::vec3 &p0 = vertices[indices[t * 3]].Position;
+				const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].Position;
+				const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].Position;
+				glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				float weight = glm::length(normal);
+				centers[c] += (p0 + p1 + p2) * (weight / 3.0f);
+				normals[c] += normal;
+				area += weight;
+			}
+			meshCenter += centers[c];
+			meshArea += area;
+			if (area > 0.0f)
+				centers[c] /= area;
+		}
+		if (meshArea > 0.0f)
+			meshCenter /= meshArea;
+
+		// clusters facing away from the center, and far out, hide the others from most views
+		std::vector<float> keys(clusterCount, 0.0f);
+		std::vector<unsigned int> order(clusterCount);
+		for (unsigned int c = 0; c < clusterCount; c++)
+		{
+			float length = glm::length(normals[c]);
+			if (length > 0.0f)
+				keys[c] = glm::dot(centers[c] - meshCenter, normals[c] / length);
+			order[c] = c;
+		}
+		std::stable_sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b) { return keys[a] > keys[b]; });
+
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+		for (unsigned int i = 0; i < clusterCount; i++)
+			result.insert(result.end(), indices.begin() + clusters[order[i]] * 3, indices.begin() + clusters[order[i] + 1] * 3);
+		indices.swap(result);
+	}
+
+	void MeshOptimizer::optimizeVertexFetch(std::vector<VertexData> &vertices, std::vector<unsigned int> &indices)
+	{
+		std::vector<unsigned int> remap(vertices.size(), 0xFFFFFFFF);
+		std::vector<VertexData> ordered;
+		ordered.reserve(vertices.size());
+		for (unsigned int i = 0; i < indices.size(); i++)
+		{
+			unsigned int v = indices[i];
+			if (remap[v] == 0xFFFFFFFF)
+			{
+				remap[v] = (unsigned int)ordered.size();
+				ordered.push_back(vertices[v]);
+			}
+			indices[i] = remap[v];
+		}
+		vertices.swap(ordered);
+	}
+
+	VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int vertexCount)
+	{
+		VertexCacheStats stats;
+		stats.triangles = (unsigned int)indices.size() / 3;
+		stats.vertices = vertexCount;
+
+		std::vector<unsigned int> cacheTimes(vertexCount, 0);
+		unsigned int time = CACHE_SIZE + 1;
+		for (unsigned int i = 0; i < stats.triangles * 3; i++)
+			if (!fetchVertex(cacheTimes, time, indices[i]))
+				stats.transforms++;
+		return stats;
+	}
+
+	float MeshOptimizer::getVertexScore(int cachePosition, unsigned int remainingTriangles)
+	{
+		// finished vertices never pull a triangle in
+		if (remainingTriangles == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			// the last triangle's vertices score a little less, or the order degrades into strips
+			if (cachePosition < 3)
+				score = 0.75f;
+			else
+				score = std::pow(1.0f - (float)(cachePosition - 3) / (SCORE_CACHE_SIZE - 3), 1.5f);
+		}
+		// vertices with few triangles left are finished first, they would cost a miss later
+		score += 2.0f * std::pow((float)remainingTriangles, -0.5f);
+		return score;
+	}
+}
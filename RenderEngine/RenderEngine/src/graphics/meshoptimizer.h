@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+namespace graphics {
+
+	struct VertexData;
+
+	// how well an index order reuses the post-transform cache, simulated as a FIFO of
+	// MeshOptimizer::CACHE_SIZE vertices. Sums over several meshes with add
+	struct VertexCacheStats {
+		unsigned int triangles;
+		unsigned int vertices;
+		unsigned int transforms;	// cache misses, every one runs the vertex shader
+
+		VertexCacheStats() : triangles(0), vertices(0), transforms(0) {}
+
+		// average cache miss ratio: transforms per triangle, 0.5 to 3
+		inline float getACMR() const { return triangles > 0 ? (float)transforms / triangles : 0.0f; }
+		// average transform to vertex ratio: transforms per vertex, 1 is ideal
+		inline float getATVR() const { return vertices > 0 ? (float)transforms / vertices : 0.0f; }
+
+		inline void add(const VertexCacheStats &other)
+		{
+			triangles += other.triangles;
+			vertices += other.vertices;
+			transforms += other.transforms;
+		}
+	};
+
+	// Import time reordering of a triangle mesh, nothing about the rendered surface changes:
+	//
+	//   optimizeVertexCache  triangle order after Forsyth's linear-speed vertex cache
+	//                        optimization, each next triangle is the one whose vertices score
+	//                        highest by cache position and remaining triangles
+	//   optimizeOverdraw     cuts that order into clusters where the cache starts over anyway and
+	//                        sorts the clusters to draw the outward facing ones first, so they
+	//                        occlude the rest (Tipsify's clustering); the cache cost stays the same
+	//   optimizeVertexFetch  renumbers the vertices in order of first use, fetches walk the vertex
+	//                        buffer front to back. Vertices no triangle uses are dropped
+	//
+	// optimize runs the three in this order on indexed triangle lists.
+	class MeshOptimizer
+	{
+	public:
+		// FIFO size the stats and cluster boundaries assume, about what current GPUs reuse
+		static const unsigned int CACHE_SIZE = 16;
+
+		// all passes, before and after (may be nullptr) receive the stats of both orders
+		static void optimize(std::vector<VertexData> &vertices, std::vector<unsigned int> &indices,
+			VertexCacheStats* before = nullptr, VertexCacheStats* after = nullptr);
+
+		static void optimizeVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount);
+		static void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<VertexData> &vertices);
+		static void optimizeVertexFetch(std::vector<VertexData> &vertices, std::vector<unsigned int> &indices);
+
+		static VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int vertexCount);
+
+	private:
+		MeshOptimizer();
+		// Forsyth's vertex score, cachePosition is -1 outside the cache
+		static float getVertexScore(int cachePosition, unsigned int remainingTriangles);
+	};
+}
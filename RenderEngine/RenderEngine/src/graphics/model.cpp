@@ -1,19 +1,129 @@
 #include "model.h"
-#include <stb/stb_image.h>
+#include "glstate.h"
+#include "uniformblocks.h"
+#include "drawtransforms.h"
+#include <algorithm>
 
 namespace graphics {
 		// constructor, expects a filepath to a 3D model.
-	Model::Model(string const &path, bool gamma) 
-		: m_GammaCorrection(gamma)
+	Model::Model(string const &path, GeometryPool* pool, TexturePool* textures, bool gamma) 
+		: m_GammaCorrection(gamma), m_Pool(pool), m_Textures(textures), m_PermutationLibrary(nullptr), m_PermutationHash(0)
 	{
 		loadModel(path);
+		computeBounds();
+
+		m_DrawRecords.resize(m_Meshes.size());
+		for (unsigned int i = 0; i < m_Meshes.size(); i++)
+		{
+			m_DrawRecords[i].firstInstance = 0;
+			m_DrawRecords[i].material = m_Meshes[i].getMaterial();
+			m_DrawRecords[i].mesh = m_Meshes[i].getMeshIndex();
+			m_DrawRecords[i].padding = 0;
+		}
+	}
+
+	void Model::Draw(ShaderLibrary* library, const ShaderDefines &sceneDefines, const glm::mat4 &model, RingBuffer* instances)
+	{
+		DrawInstanced(library, sceneDefines, &model, 1, instances);
+	}
+
+	void Model::DrawInstanced(ShaderLibrary* library, const ShaderDefines &sceneDefines, const glm::mat4* models, unsigned int count, RingBuffer* instances)
+	{
+		if (count == 0)
+			return;
+		prepareShaders(library, sceneDefines);
+
+		// one range of transforms for the whole model, every mesh reads the same instances
+		if (!DrawTransforms::push(models, count, instances) || !pushDrawRecords(instances))
+			return;
+
+		Shader* current = nullptr;
+		for (unsigned int i = 0; i < m_Meshes.size(); i++)
+		{
+			Shader* shader = m_MeshShaders[i];
+			if (!shader->isReady())
+				continue;
+			// meshes sharing a permutation share the program switch
+			if (shader != current)
+			{
+				shader->enable();
+				current = shader;
+			}
+			m_Meshes[i].Draw(count, i);
+		}
+		if (current != nullptr)
+			current->disable();
+	}
+
+	void Model::Submit(RenderQueue* queue, ShaderLibrary* library, const ShaderDefines &sceneDefines, const glm::mat4* models, unsigned int count, RenderPass pass)
+	{
+		if (count == 0)
+			return;
+		prepareShaders(library, sceneDefines);
+
+		unsigned int baseInstance;
+		if (!queue->addInstances(models, count, baseInstance))
+			return;
+		glm::vec3 center;
+		float radius;
+		getBoundingSphere(models[0], center, radius);
+		float depth = queue->viewDepth(center);
+
+		for (unsigned int i = 0; i < m_Meshes.size(); i++)
+			if (m_MeshShaders[i]->isReady())
+				queue->submit(pass, m_MeshShaders[i], &m_Meshes[i], depth, baseInstance, count);
+	}
+
+	void Model::DrawDepth(const glm::mat4 &model, RingBuffer* instances)
+	{
+		DrawDepthInstanced(&model, 1, instances);
+	}
+
+	void Model::DrawDepthInstanced(const glm::mat4* models, unsigned int count, RingBuffer* instances)
+	{
+		if (count == 0 || !DrawTransforms::push(models, count, instances) || !pushDrawRecords(instances))
+			return;
+
+		for (unsigned int i = 0; i < m_Meshes.size(); i++)
+			m_Meshes[i].DrawDepth(count, i);
+	}
+
+	bool Model::pushDrawRecords(RingBuffer* instances)
+	{
+		if (m_DrawRecords.empty())
+			return false;
+		unsigned int size = (unsigned int)m_DrawRecords.size() * sizeof(DrawRecord);
+		int offset = instances->push(&m_DrawRecords[0], size);
+		if (offset < 0)
+			return false;
+		instances->bindRange(DRAW_STORAGE_BINDING, offset, size);
+		return true;
 	}
 
-	// draws the model, and thus all its meshes
-	void Model::Draw(Shader* shader)
+	void Model::getBoundingSphere(const glm::mat4 &model, glm::vec3 &center, float &radius) const
 	{
+		center = glm::vec3(model * glm::vec4(m_BoundsCenter, 1.0f));
+		// the largest axis scale bounds any shear or non-uniform scale
+		float scale = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+		radius = m_BoundsRadius * scale;
+	}
+
+	void Model::prepareShaders(ShaderLibrary* library, const ShaderDefines &sceneDefines)
+	{
+		// runs on every draw, the hash doesn't allocate like the define source would
+		unsigned long long hash = sceneDefines.getHash();
+		if (library == m_PermutationLibrary && hash == m_PermutationHash)
+			return;
+
+		m_PermutationLibrary = library;
+		m_PermutationHash = hash;
+		m_MeshShaders.resize(m_Meshes.size());
 		for (unsigned int i = 0; i < m_Meshes.size(); i++)
-			m_Meshes[i].Draw(shader);
+		{
+			ShaderDefines defines = sceneDefines;
+			m_Meshes[i].getMaterialDefines(defines);
+			m_MeshShaders[i] = library->get(defines);
+		}
 	}
 
 	/*  Functions   */
@@ -22,7 +132,7 @@ namespace graphics {
 	{
 		// read file via ASSIMP
 		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 		// check for errors
 		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
 		{
@@ -32,8 +142,46 @@ namespace graphics {
 		// retrieve the directory path of the filepath
 		m_Directory = path.substr(0, path.find_last_of('/'));
 
+		// announce every material map first, so the TexturePool sizes its slabs to what is coming
+		aiTextureType types[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT };
+		for (unsigned int m = 0; m < scene->mNumMaterials; m++)
+			for (unsigned int t = 0; t < 3; t++)
+				for (unsigned int i = 0; i < scene->mMaterials[m]->GetTextureCount(types[t]); i++)
+				{
+					aiString str;
+					scene->mMaterials[m]->GetTexture(types[t], i, &str);
+					m_Textures->expect(m_Directory + '/' + string(str.C_Str()));
+				}
+
 		// process ASSIMP's root node recursively
 		processNode(scene->mRootNode, scene);
+
+		std::cout << "Model " << path << ": " << m_CacheAfter.triangles << " triangles, ACMR "
+			<< m_CacheBefore.getACMR() << " -> " << m_CacheAfter.getACMR() << ", ATVR "
+			<< m_CacheBefore.getATVR() << " -> " << m_CacheAfter.getATVR() << std::endl;
+	}
+
+	void Model::computeBounds()
+	{
+		// sphere around the box of all vertices, tight enough for culling
+		glm::vec3 minimum(1e30f), maximum(-1e30f);
+		for (unsigned int i = 0; i < m_Meshes.size(); i++)
+			for (unsigned int j = 0; j < m_Meshes[i].m_Vertices.size(); j++)
+			{
+				minimum = glm::min(minimum, m_Meshes[i].m_Vertices[j].Position);
+				maximum = glm::max(maximum, m_Meshes[i].m_Vertices[j].Position);
+			}
+		if (minimum.x > maximum.x)
+		{
+			m_BoundsCenter = glm::vec3(0.0f);
+			m_BoundsRadius = 0.0f;
+			return;
+		}
+		m_BoundsCenter = (minimum + maximum) * 0.5f;
+		m_BoundsRadius = 0.0f;
+		for (unsigned int i = 0; i < m_Meshes.size(); i++)
+			for (unsigned int j = 0; j < m_Meshes[i].m_Vertices.size(); j++)
+				m_BoundsRadius = std::max(m_BoundsRadius, glm::length(m_Meshes[i].m_Vertices[j].Position - m_BoundsCenter));
 	}
 
 	// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -110,14 +258,15 @@ namespace graphics {
 			for (unsigned int j = 0; j < face.mNumIndices; j++)
 				indices.push_back(face.mIndices[j]);
 		}
+		// triangle order for the vertex cache and overdraw, vertex order for the fetches
+		VertexCacheStats before, after;
+		MeshOptimizer::optimize(vertices, indices, &before, &after);
+		m_CacheBefore.add(before);
+		m_CacheAfter.add(after);
 		// process materials
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		// we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-		// as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-		// Same applies to other texture as the following list summarizes:
-		// diffuse: texture_diffuseN
-		// specular: texture_specularN
-		// normal: texture_normalN
+		// the first map of each type becomes a layer the shaders sample through the Materials block,
+		// see Mesh::setupMaterial
 
 		// 1. diffuse maps
 		vector<TextureData> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
@@ -128,16 +277,13 @@ namespace graphics {
 		// 3. normal maps
 		std::vector<TextureData> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-		// 4. height maps
-		std::vector<TextureData> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
 		// return a mesh object created from the extracted mesh data
-		return Mesh(vertices, indices, textures);
+		return Mesh(vertices, indices, textures, 32.0f, m_Pool, m_Textures);
 	}
 
-	// checks all material textures of a given type and loads the textures if they're not loaded yet.
-	// the required info is returned as a Texture struct.
+	// loads all material textures of a given type into the TexturePool, which skips files it
+	// already holds. The required info is returned as a Texture struct.
 	vector<TextureData> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
 	{
 		vector<TextureData> textures;
@@ -145,68 +291,12 @@ namespace graphics {
 		{
 			aiString str;
 			mat->GetTexture(type, i, &str);
-			// check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-			bool skip = false;
-			for (unsigned int j = 0; j < m_TextureLoaded.size(); j++)
-			{
-				if (std::strcmp(m_TextureLoaded[j].path.C_Str(), str.C_Str()) == 0)
-				{
-					textures.push_back(m_TextureLoaded[j]);
-					skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-					break;
-				}
-			}
-			if (!skip)
-			{   // if texture hasn't been loaded already, load it
-				TextureData texture;
-				texture.id = TextureFromFile(str.C_Str(), this->m_Directory);
-				texture.type = typeName;
-				texture.path = str;
-				textures.push_back(texture);
-				m_TextureLoaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-			}
+			TextureData texture;
+			texture.location = m_Textures->load(m_Directory + '/' + string(str.C_Str()));
+			texture.type = typeName;
+			texture.path = str;
+			textures.push_back(texture);
 		}
 		return textures;
 	}
-
-
-	unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-	{
-		string filename = string(path);
-		filename = directory + '/' + filename;
-
-		unsigned int textureID;
-		glGenTextures(1, &textureID);
-
-		int width, height, nrComponents;
-		unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-		if (data)
-		{
-			GLenum format;
-			if (nrComponents == 1)
-				format = GL_RED;
-			else if (nrComponents == 3)
-				format = GL_RGB;
-			else if (nrComponents == 4)
-				format = GL_RGBA;
-
-			glBindTexture(GL_TEXTURE_2D, textureID);
-			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Texture failed to load at path: " << path << std::endl;
-			stbi_image_free(data);
-		}
-
-		return textureID;
-	}
-}
+}
\ No newline at end of file
@@ -10,7 +10,11 @@
 #include <assimp/postprocess.h>
 
 #include "shader.h"
+#include "shaderlibrary.h"
+#include "buffers/ringbuffer.h"
 #include "mesh.h"
+#include "renderqueue.h"
+#include "meshoptimizer.h"
 
 #include <string>
 #include <fstream>
@@ -25,35 +29,74 @@ namespace graphics {
 	{
 	public:
 		/*  Model Data */
-		vector<TextureData> m_TextureLoaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
 		vector<Mesh> m_Meshes;
 		string m_Directory;
 		bool m_GammaCorrection;
+		// bounding sphere of all meshes in model space
+		glm::vec3 m_BoundsCenter;
+		float m_BoundsRadius;
+
+	private:
+		GeometryPool* m_Pool;
+		TexturePool* m_Textures;
+		// record i draws mesh i from the first bound instance, for the immediate draws
+		vector<DrawRecord> m_DrawRecords;
+		// permutation picked for each mesh, resolved again when the scene defines change
+		ShaderLibrary* m_PermutationLibrary;
+		unsigned long long m_PermutationHash;
+		vector<Shader*> m_MeshShaders;
+		// post-transform cache use of all meshes as in the file and after MeshOptimizer
+		VertexCacheStats m_CacheBefore, m_CacheAfter;
 
 	public:
 		/*  Functions   */
-		// constructor, expects a filepath to a 3D model.
-		Model(string const &path, bool gamma = false);
+		// constructor, expects a filepath to a 3D model. The meshes' geometry goes into pool and
+		// their maps and materials into textures
+		Model(string const &path, GeometryPool* pool, TexturePool* textures, bool gamma = false);
+
+		// draws every mesh with the library's permutation for the scene defines plus the mesh's
+		// own texture defines; meshes whose permutation is still compiling are skipped.
+		// the model matrix goes to the Instances block and the draw records to the Draws block
+		// through instances, a storage buffer ring. The TexturePool's materials have to be bound
+		void Draw(ShaderLibrary* library, const ShaderDefines &sceneDefines, const glm::mat4 &model, RingBuffer* instances);
+
+		// count copies of the model in one draw call per mesh, one model matrix each
+		void DrawInstanced(ShaderLibrary* library, const ShaderDefines &sceneDefines, const glm::mat4* models, unsigned int count, RingBuffer* instances);
+
+		// queues every mesh for count instances instead of drawing right away. The queue sorts
+		// the model by the first instance's distance and merges its meshes into multi draws
+		void Submit(RenderQueue* queue, ShaderLibrary* library, const ShaderDefines &sceneDefines, const glm::mat4* models, unsigned int count, RenderPass pass = OPAQUE_PASS);
 
-		// draws the model, and thus all its meshes
-		void Draw(Shader* shader);
+		// depth only draw of every mesh for shadow passes, the caller binds the depth program
+		void DrawDepth(const glm::mat4 &model, RingBuffer* instances);
+		void DrawDepthInstanced(const glm::mat4* models, unsigned int count, RingBuffer* instances);
+
+		// bounding sphere in world space for the given model matrix
+		void getBoundingSphere(const glm::mat4 &model, glm::vec3 &center, float &radius) const;
+
+		// picks (and starts compiling) the permutations ahead of the first draw
+		void prepareShaders(ShaderLibrary* library, const ShaderDefines &sceneDefines);
 
 	private:
 		/*  Functions   */
 		// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
 		void loadModel(string const &path);
 
+		// uploads m_DrawRecords and binds them to the Draws block
+		bool pushDrawRecords(RingBuffer* instances);
+
+		// fits m_BoundsCenter and m_BoundsRadius around every vertex
+		void computeBounds();
+
 		// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
 		void processNode(aiNode *node, const aiScene *scene);
 
 		Mesh processMesh(aiMesh *mesh, const aiScene *scene);
 		
 
-		// checks all material textures of a given type and loads the textures if they're not loaded yet.
-		// the required info is returned as a Texture struct.
+		// loads all material textures of a given type into the TexturePool, which skips files it
+		// already holds. The required info is returned as a Texture struct.
 		vector<TextureData> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName);
 
-		friend static unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
-
 	};
 }
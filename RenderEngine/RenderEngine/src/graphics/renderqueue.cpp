@@ -0,0 +1,317 @@
+#include "renderqueue.h"
+#include "glstate.h"
+#include "drawtransforms.h"
+
+#include <algorithm>
+
+namespace graphics {
+
+	static const unsigned int PROGRAM_BITS = 12;
+	static const unsigned int MATERIAL_BITS = 14;
+	static const unsigned int GEOMETRY_BITS = 16;
+	static const unsigned int DEPTH_BITS = 20;
+
+	static unsigned int getIndexTypeID(GLenum type)
+	{
+		if (type == GL_UNSIGNED_BYTE)
+			return 0;
+		if (type == GL_UNSIGNED_SHORT)
+			return 1;
+		return 2;
+	}
+
+	RenderQueue::RenderQueue(unsigned int maxCommands)
+		:m_InstanceRing(nullptr), m_Instances(nullptr), m_InstanceOffset(0), m_InstanceCount(0), m_InstanceCapacity(0),
+		m_DroppedInstances(0), m_View(1.0f), m_FarPlane(100.0f)
+	{
+		m_Indirect = new RingBuffer(GL_DRAW_INDIRECT_BUFFER, maxCommands * sizeof(IndirectCommand));
+	}
+
+	RenderQueue::~RenderQueue()
+	{
+		delete m_Indirect;
+	}
+
+	void RenderQueue::begin(const glm::mat4 &view, float farPlane, RingBuffer* instances)
+	{
+		m_View = view;
+		m_FarPlane = farPlane;
+		m_Commands.clear();
+		m_Entries.clear();
+		m_Indirect->beginFrame();
+
+		unsigned int freeSize;
+		m_InstanceRing = instances;
+		m_Instances = (DrawBlock*)instances->getFree(m_InstanceOffset, freeSize);
+		m_InstanceCount = 0;
+		m_InstanceCapacity = freeSize / sizeof(DrawBlock);
+		m_DroppedInstances = 0;
+	}
+
+	bool RenderQueue::addInstances(const glm::mat4* models, unsigned int count, unsigned int &baseInstance)
+	{
+		if (count > m_InstanceCapacity - m_InstanceCount)
+		{
+			m_DroppedInstances += count;
+			return false;
+		}
+		baseInstance = m_InstanceCount;
+		DrawTransforms::compute(models, count, m_Instances + baseInstance);
+		m_InstanceCount += count;
+		return true;
+	}
+
+	void RenderQueue::submit(RenderPass pass, Shader* shader, Mesh* mesh, float depth, unsigned int baseInstance, unsigned int instanceCount)
+	{
+		if (instanceCount == 0)
+			return;
+
+		Command command;
+		command.shader = shader;
+		command.mesh = mesh;
+		command.material = getMaterialID(mesh);
+		command.baseInstance = baseInstance;
+		command.instanceCount = instanceCount;
+
+		// ids past their field wrap around, that only costs sorting quality since execute()
+		// compares the real objects
+		unsigned long long program = getProgramID(shader) & ((1ull << PROGRAM_BITS) - 1);
+		unsigned long long material = command.material & ((1ull << MATERIAL_BITS) - 1);
+		// the index type splits multi draws like the pool, keep meshes of one type together
+		unsigned long long geometry = (mesh->getVertexArray() << 2 | getIndexTypeID(mesh->getIndexType())) & ((1ull << GEOMETRY_BITS) - 1);
+		unsigned long long depthMax = (1ull << DEPTH_BITS) - 1;
+		unsigned long long bucket = (unsigned long long)(std::min(std::max(depth / m_FarPlane, 0.0f), 1.0f) * depthMax);
+
+		unsigned long long key = (unsigned long long)pass << 62;
+		if (pass == OPAQUE_PASS)
+			key |= program << 50 | material << 36 | geometry << 20 | bucket;
+		else
+			key |= (depthMax - bucket) << 42 | program << 30 | material << 16 | geometry;
+
+		SortEntry entry;
+		entry.key = key;
+		entry.command = (unsigned int)m_Commands.size();
+		m_Commands.push_back(command);
+		m_Entries.push_back(entry);
+	}
+
+	void RenderQueue::execute()
+	{
+		RingBuffer* instances = m_InstanceRing;
+		unsigned int instanceSize = m_InstanceCount * sizeof(DrawBlock);
+		instances->commit(instanceSize);
+		if (m_DroppedInstances > 0)
+			std::cout << "ERROR::RENDERQUEUE::INSTANCES_DROPPED " << m_DroppedInstances << " instances didn't fit the instance ring ("
+				<< m_InstanceCapacity << " free)" << std::endl;
+
+		sort();
+		buildBatches();
+
+		// one range for every instance of the frame, and one each for the records and commands
+		int recordOffset = -1, indirectOffset = -1;
+		unsigned int recordSize = (unsigned int)m_DrawRecords.size() * sizeof(DrawRecord);
+		unsigned int indirectSize = (unsigned int)m_IndirectCommands.size() * sizeof(IndirectCommand);
+		if (!m_Batches.empty())
+		{
+			// a frame's commands always fit, the ring is replaced by one twice the size. The old
+			// buffer is only freed by GL once the frames still reading it are done
+			if (indirectSize > m_Indirect->getFrameSize())
+			{
+				unsigned int maxCommands = m_Indirect->getFrameSize() / sizeof(IndirectCommand);
+				while (maxCommands * sizeof(IndirectCommand) < indirectSize)
+					maxCommands *= 2;
+				std::cout << "Render queue: indirect buffer grown to " << maxCommands << " commands" << std::endl;
+				delete m_Indirect;
+				m_Indirect = new RingBuffer(GL_DRAW_INDIRECT_BUFFER, maxCommands * sizeof(IndirectCommand));
+			}
+			recordOffset = instances->push(&m_DrawRecords[0], recordSize);
+			indirectOffset = m_Indirect->push(&m_IndirectCommands[0], indirectSize);
+			if (recordOffset < 0 || indirectOffset < 0)
+				std::cout << "ERROR::RENDERQUEUE::OUT_OF_SPACE " << m_IndirectCommands.size() << " draws dropped this frame" << std::endl;
+		}
+		if (recordOffset >= 0 && indirectOffset >= 0)
+		{
+			instances->bindRange(INSTANCE_STORAGE_BINDING, m_InstanceOffset, instanceSize);
+			instances->bindRange(DRAW_STORAGE_BINDING, recordOffset, recordSize);
+			m_Indirect->bind(indirectOffset, indirectSize);
+
+			Shader* program = nullptr;
+			unsigned int material = 0xFFFFFFFF;
+			unsigned int geometry = 0;
+			int pass = -1;
+			for (unsigned int b = 0; b < m_Batches.size(); b++)
+			{
+				const Batch &batch = m_Batches[b];
+				const Command &command = m_Commands[m_Entries[batch.first].command];
+
+				int batchPass = (int)(m_Entries[batch.first].key >> 62);
+				if (batchPass != pass)
+				{
+					// transparent surfaces blend over the opaque ones without hiding each other
+					pass = batchPass;
+					GLState::setBlend(pass == TRANSPARENT_PASS);
+					GLState::setDepthMask(pass != TRANSPARENT_PASS);
+					if (pass == TRANSPARENT_PASS)
+						GLState::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				}
+				if (command.shader != program)
+				{
+					command.shader->enable();
+					program = command.shader;
+					m_Stats.programs++;
+				}
+				if (command.material != material)
+				{
+					command.mesh->bindMaterial();
+					material = command.material;
+					m_Stats.materials++;
+				}
+				if (command.mesh->getVertexArray() != geometry)
+				{
+					command.mesh->bindGeometry();
+					geometry = command.mesh->getVertexArray();
+					m_Stats.geometry++;
+				}
+				command.mesh->getPool()->reserveDraws((unsigned int)m_IndirectCommands.size());
+				glMultiDrawElementsIndirect(GL_TRIANGLES, command.mesh->getIndexType(),
+					(void*)(size_t)(indirectOffset + batch.indirect * sizeof(IndirectCommand)), batch.count, 0);
+				m_Stats.draws += batch.count;
+				m_Stats.multiDraws++;
+			}
+
+			if (pass == TRANSPARENT_PASS)
+			{
+				GLState::setBlend(false);
+				GLState::setDepthMask(true);
+			}
+			if (program != nullptr)
+				program->disable();
+#if GLSTATE_UNBIND
+			GLState::bindVertexArray(0);
+#endif
+		}
+		m_Indirect->endFrame();
+		m_Stats.frames++;
+	}
+
+	void RenderQueue::buildBatches()
+	{
+		m_Batches.clear();
+		m_IndirectCommands.clear();
+		m_DrawRecords.clear();
+		for (unsigned int i = 0; i < m_Entries.size(); i++)
+		{
+			const Command &command = m_Commands[m_Entries[i].command];
+
+			// a batch can't switch the pass, the program, the material, the pool or the index type
+			bool joins = false;
+			if (!m_Batches.empty())
+			{
+				const SortEntry &first = m_Entries[m_Batches.back().first];
+				const Command &batchCommand = m_Commands[first.command];
+				joins = (first.key >> 62) == (m_Entries[i].key >> 62) && batchCommand.shader == command.shader &&
+					batchCommand.material == command.material && batchCommand.mesh->getPool() == command.mesh->getPool() &&
+					batchCommand.mesh->getIndexType() == command.mesh->getIndexType();
+			}
+			if (!joins)
+			{
+				Batch batch;
+				batch.first = i;
+				batch.count = 0;
+				batch.indirect = (unsigned int)m_IndirectCommands.size();
+				m_Batches.push_back(batch);
+			}
+
+			IndirectCommand indirect;
+			indirect.count = command.mesh->getIndexCount();
+			indirect.instanceCount = command.instanceCount;
+			indirect.firstIndex = command.mesh->getFirstIndex();
+			indirect.baseVertex = (int)command.mesh->getBaseVertex();
+			indirect.baseInstance = (unsigned int)m_IndirectCommands.size();
+			m_IndirectCommands.push_back(indirect);
+
+			DrawRecord record;
+			record.firstInstance = command.baseInstance;
+			record.material = command.mesh->getMaterial();
+			record.mesh = command.mesh->getMeshIndex();
+			record.padding = 0;
+			m_DrawRecords.push_back(record);
+			m_Batches.back().count++;
+		}
+	}
+
+	void RenderQueue::printStats() const
+	{
+		if (m_Stats.frames == 0)
+			return;
+		double frames = (double)m_Stats.frames;
+		std::cout << "Render queue per frame: " << m_Stats.draws / frames << " draws in "
+			<< m_Stats.multiDraws / frames << " multi draws, "
+			<< m_Stats.programs / frames << " program switches, "
+			<< m_Stats.materials / frames << " material binds, "
+			<< m_Stats.geometry / frames << " vertex array binds" << std::endl;
+	}
+
+	unsigned int RenderQueue::getProgramID(const Shader* shader)
+	{
+		std::unordered_map<const Shader*, unsigned int>::iterator it = m_ProgramIDs.find(shader);
+		if (it != m_ProgramIDs.end())
+			return it->second;
+		unsigned int id = (unsigned int)m_ProgramIDs.size();
+		m_ProgramIDs[shader] = id;
+		return id;
+	}
+
+	unsigned int RenderQueue::getMaterialID(const Mesh* mesh)
+	{
+		std::unordered_map<const Mesh*, unsigned int>::iterator it = m_MeshMaterials.find(mesh);
+		if (it != m_MeshMaterials.end())
+			return it->second;
+
+		// everything bindMaterial sets: the array texture of each unit
+		std::vector<unsigned int> material;
+		for (unsigned int i = 0; i < MATERIAL_MAP_COUNT; i++)
+			material.push_back(mesh->getSlab(i));
+
+		std::map<std::vector<unsigned int>, unsigned int>::iterator known = m_MaterialIDs.find(material);
+		unsigned int id;
+		if (known != m_MaterialIDs.end())
+			id = known->second;
+		else
+		{
+			id = (unsigned int)m_MaterialIDs.size();
+			m_MaterialIDs[material] = id;
+		}
+		m_MeshMaterials[mesh] = id;
+		return id;
+	}
+
+	void RenderQueue::sort()
+	{
+		unsigned int count = (unsigned int)m_Entries.size();
+		if (count < 2)
+			return;
+		m_Scratch.resize(count);
+		for (unsigned int shift = 0; shift < 64; shift += 8)
+		{
+			unsigned int histogram[256] = { 0 };
+			for (unsigned int i = 0; i < count; i++)
+				histogram[(m_Entries[i].key >> shift) & 0xFF]++;
+			// the digit is the same for every key, the pass wouldn't move anything
+			if (histogram[(m_Entries[0].key >> shift) & 0xFF] == count)
+				continue;
+
+			unsigned int offsets[256];
+			unsigned int sum = 0;
+			for (unsigned int digit = 0; digit < 256; digit++)
+			{
+				offsets[digit] = sum;
+				sum += histogram[digit];
+			}
+			// stable, so the order of the lower digits survives
+			for (unsigned int i = 0; i < count; i++)
+				m_Scratch[offsets[(m_Entries[i].key >> shift) & 0xFF]++] = m_Entries[i];
+			m_Entries.swap(m_Scratch);
+		}
+	}
+}
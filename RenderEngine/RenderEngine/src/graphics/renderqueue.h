@@ -0,0 +1,156 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "shader.h"
+#include "mesh.h"
+#include "uniformblocks.h"
+#include "buffers/ringbuffer.h"
+
+namespace graphics {
+
+	// passes of the RenderQueue, executed in this order
+	enum RenderPass {
+		OPAQUE_PASS = 0,
+		TRANSPARENT_PASS = 1
+	};
+
+	struct RenderQueueStats {
+		unsigned long long frames;
+		unsigned long long draws;		// meshes drawn
+		unsigned long long multiDraws;	// glMultiDrawElementsIndirect calls
+		unsigned long long programs;	// program switches
+		unsigned long long materials;	// material texture array binds
+		unsigned long long geometry;	// vertex array binds
+
+		RenderQueueStats() : frames(0), draws(0), multiDraws(0), programs(0), materials(0), geometry(0) {}
+	};
+
+	// Collects the draws of a frame and issues them in the order that needs the fewest state
+	// changes. Every submission gets a 64 bit sort key, most significant field first:
+	//
+	//   opaque:       pass:2 | program:12 | material:14 | geometry:16 | depth:20
+	//   transparent:  pass:2 | inverted depth:20 | program:12 | material:14 | geometry:16
+	//
+	// where geometry is the vertex array and, in the low 2 bits, the index type of the mesh.
+	// Opaque draws are grouped by program, then material slabs, then geometry pool, and go front to
+	// back inside a group so early depth testing rejects more; transparent draws go back to front
+	// for the blending and only share state at equal depth. The keys are radix sorted.
+	//
+	// Sorted neighbours with the same program, material slabs, pool and index type become one
+	// batch: their draw commands are written to an indirect buffer and issued with a single
+	// glMultiDrawElementsIndirect, so the CPU cost follows the number of state changes rather
+	// than the number of meshes. The instances of the whole frame are computed straight into the
+	// instance ring, the queue holds its free space from begin to execute and binds what it used
+	// as one range of the Instances block. Every command gets a record of the Draws block with
+	// its first instance and material; the command's base instance is the index of its record,
+	// see GeometryPool. The indirect buffer grows when a frame has more commands than it holds.
+	// The TexturePool's materials have to be bound before execute.
+	//
+	// per frame:
+	//   begin(view, farPlane, instances), nothing else may allocate from instances until execute
+	//   Model::Submit(queue, ...), or addInstances(...) and submit(...) for every draw
+	//   execute()
+	class RenderQueue
+	{
+	private:
+		struct Command {
+			Shader* shader;
+			Mesh* mesh;
+			unsigned int material;
+			unsigned int baseInstance;
+			unsigned int instanceCount;
+		};
+
+		struct SortEntry {
+			unsigned long long key;
+			unsigned int command;
+		};
+
+		// layout glMultiDrawElementsIndirect reads
+		struct IndirectCommand {
+			unsigned int count;
+			unsigned int instanceCount;
+			unsigned int firstIndex;
+			int baseVertex;
+			unsigned int baseInstance;
+		};
+
+		// sorted entries [first, first + count), their commands start at indirect
+		struct Batch {
+			unsigned int first;
+			unsigned int count;
+			unsigned int indirect;
+		};
+
+		std::vector<Command> m_Commands;
+		// sorted keys, and the scratch array of the radix passes
+		std::vector<SortEntry> m_Entries, m_Scratch;
+		// the frame's instances, written to the free space of the instance ring
+		RingBuffer* m_InstanceRing;
+		DrawBlock* m_Instances;
+		unsigned int m_InstanceOffset;
+		unsigned int m_InstanceCount;
+		unsigned int m_InstanceCapacity;
+		// instances that didn't fit this frame, reported once by execute
+		unsigned int m_DroppedInstances;
+		std::vector<IndirectCommand> m_IndirectCommands;
+		// one per indirect command, the command's base instance is its index
+		std::vector<DrawRecord> m_DrawRecords;
+		std::vector<Batch> m_Batches;
+		RingBuffer* m_Indirect;
+
+		glm::mat4 m_View;
+		float m_FarPlane;
+
+		// small ids for the key fields, handed out on first sight and kept across frames
+		std::unordered_map<const Shader*, unsigned int> m_ProgramIDs;
+		std::map<std::vector<unsigned int>, unsigned int> m_MaterialIDs;
+		std::unordered_map<const Mesh*, unsigned int> m_MeshMaterials;
+
+		RenderQueueStats m_Stats;
+
+	public:
+		// maxCommands bounds the meshes drawn per frame
+		RenderQueue(unsigned int maxCommands = 4096);
+		~RenderQueue();
+
+		// drops last frame's submissions, depth buckets are spread up to farPlane. The frame's
+		// instances go to the free space of instances
+		void begin(const glm::mat4 &view, float farPlane, RingBuffer* instances);
+
+		// adds transforms to the frame's instances, baseInstance receives the base instance of the
+		// first. False if the instance ring ran out of space
+		bool addInstances(const glm::mat4* models, unsigned int count, unsigned int &baseInstance);
+
+		// queues instances baseInstance to baseInstance + instanceCount - 1 of the mesh, depth is
+		// the view space distance of the draw, see viewDepth. The program has to be ready
+		void submit(RenderPass pass, Shader* shader, Mesh* mesh, float depth, unsigned int baseInstance, unsigned int instanceCount);
+
+		// sorts, batches and issues the submissions
+		void execute();
+
+		// distance in front of the camera of begin()
+		inline float viewDepth(const glm::vec3 &position) const { return -(m_View * glm::vec4(position, 1.0f)).z; }
+
+		inline unsigned int getSize() const { return (unsigned int)m_Commands.size(); }
+		inline const RenderQueueStats &getStats() const { return m_Stats; }
+
+		void printStats() const;
+
+	private:
+		unsigned int getProgramID(const Shader* shader);
+		// meshes whose maps come from the same slabs share an id and their bind, the layers and
+		// constants differ per draw through the Materials block
+		unsigned int getMaterialID(const Mesh* mesh);
+		// 8 passes of 8 bits, passes where every key has the same digit are skipped
+		void sort();
+		// groups the sorted entries and fills m_IndirectCommands and m_DrawRecords
+		void buildBatches();
+	};
+}
@@ -1,29 +1,98 @@
 #include "shader.h"
+#include "shadercache.h"
+#include "glextensions.h"
+#include "glstate.h"
+
+#include <algorithm>
 
 namespace graphics {
 
+	// Shader defines
+	//-------------------
+	ShaderDefines& ShaderDefines::set(const std::string &name, const std::string &value)
+	{
+		std::vector<std::pair<std::string, std::string> >::iterator it = m_Defines.begin();
+		while (it != m_Defines.end() && it->first < name)
+			++it;
+		if (it != m_Defines.end() && it->first == name)
+			it->second = value;
+		else
+			m_Defines.insert(it, std::make_pair(name, value));
+		return *this;
+	}
+
+	ShaderDefines& ShaderDefines::set(const std::string &name, int value)
+	{
+		std::stringstream ss;
+		ss << value;
+		return set(name, ss.str());
+	}
+
+	std::string ShaderDefines::getSource() const
+	{
+		std::string source;
+		for (size_t i = 0; i < m_Defines.size(); i++)
+			source += "#define " + m_Defines[i].first + " " + m_Defines[i].second + "\n";
+		return source;
+	}
+
+	// 64 bit FNV-1a, a 0 byte separates the names and values
+	unsigned long long ShaderDefines::getHash() const
+	{
+		unsigned long long hash = 14695981039346656037ull;
+		for (size_t i = 0; i < m_Defines.size(); i++)
+		{
+			const std::string* parts[2] = { &m_Defines[i].first, &m_Defines[i].second };
+			for (int p = 0; p < 2; p++)
+			{
+				for (size_t c = 0; c < parts[p]->size(); c++)
+				{
+					hash ^= (unsigned char)(*parts[p])[c];
+					hash *= 1099511628211ull;
+				}
+				hash *= 1099511628211ull;
+			}
+		}
+		return hash;
+	}
+
 	// Shader Constructor
 	//-------------------
-	Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
+	Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, bool async)
+		: Shader(vertexPath, fragmentPath, geometryPath, ShaderDefines(), async)
+	{
+	}
+
+	Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const ShaderDefines &defines, bool async)
+		: m_Status(SHADER_PENDING), m_VertexShaderID(0), m_FragmentShaderID(0), m_GeometryShaderID(0),
+		m_Defines(defines.getSource())
 	{
-		std::string vertexShaderStr = readFile(vertexPath, "VERTEX");
+		std::string vertexShaderStr = injectDefines(readFile(vertexPath, "VERTEX"));
 		m_VertexShaderSource = vertexShaderStr.c_str();
-		std::string fragmentShaderStr = readFile(fragmentPath, "FRAGMENT");
+		std::string fragmentShaderStr = injectDefines(readFile(fragmentPath, "FRAGMENT"));
 		m_FragmentShaderSource = fragmentShaderStr.c_str();
+		// must outlive load(), which hands the pointer to glShaderSource
+		std::string geometryShaderStr;
 		if (geometryPath != nullptr) {
-			std::string geometryShaderStr = readFile(geometryPath, "GEOMETRY");
+			geometryShaderStr = injectDefines(readFile(geometryPath, "GEOMETRY"));
 			m_GeometryShaderSource = geometryShaderStr.c_str();
 		}
 		else {
 			m_GeometryShaderSource = nullptr;
 		}
 		m_ShaderID = load();
+		if (m_Status == SHADER_READY)
+			buildUniformTable();
+		else if (!async)
+			finalize();
 	}
 
 	// Shader destructor
 	//-------------------
 	Shader::~Shader() {
-		glDeleteProgram(m_ShaderID);
+		if (m_Status == SHADER_PENDING)
+			finalize();
+		GLState::deleteProgram(m_ShaderID);
 	}
 
 	std::string  Shader::readFile(const char* shaderPath, std::string shaderType)
@@ -47,52 +116,126 @@ namespace graphics {
 		return shaderCode;
 	}
 
+	// defines have to follow the #version line, #line keeps the compiler's line numbers matching the file
+	std::string Shader::injectDefines(const std::string &source) const
+	{
+		if (m_Defines.empty())
+			return source;
+		size_t version = source.find("#version");
+		if (version == std::string::npos)
+			return m_Defines + "#line 1\n" + source;
+		size_t lineEnd = source.find('\n', version);
+		if (lineEnd == std::string::npos)
+			return source + "\n" + m_Defines;
+		size_t line = 1 + std::count(source.begin(), source.begin() + lineEnd, '\n') + 1;
+		std::stringstream injected;
+		injected << source.substr(0, lineEnd + 1) << m_Defines << "#line " << line << "\n" << source.substr(lineEnd + 1);
+		return injected.str();
+	}
+
 	// build and compile our shader program
 	// ------------------------------------
+	// only submits the work, none of the status queries that would make the driver finish
+	// the compile are issued here; see finalize()
 	int Shader::load()
 	{
-		
-		int vertexShader, fragmentShader, geometryShader, shaderProgram;
+		// reuse the driver's binary from an earlier run when the sources and driver are unchanged
+		std::vector<const char*> sources;
+		sources.push_back(m_VertexShaderSource);
+		sources.push_back(m_FragmentShaderSource);
+		sources.push_back(m_GeometryShaderSource);
+		m_CacheKey = ShaderCache::computeKey(sources, m_Defines);
+
+		int shaderProgram = glCreateProgram();
+		if (ShaderCache::load(shaderProgram, m_CacheKey))
+		{
+			m_Status = SHADER_READY;
+			return shaderProgram;
+		}
+		// start from a clean program object if the driver rejected the cached binary
+		glDeleteProgram(shaderProgram);
+
 		// vertex shader
-		vertexShader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertexShader, 1, &m_VertexShaderSource, NULL);
-		glCompileShader(vertexShader);
-		checkCompileErrors(vertexShader, "VERTEX");
+		m_VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(m_VertexShaderID, 1, &m_VertexShaderSource, NULL);
+		glCompileShader(m_VertexShaderID);
 
 		// fragment shader
-		fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragmentShader, 1, &m_FragmentShaderSource, NULL);
-		glCompileShader(fragmentShader);
-		checkCompileErrors(fragmentShader, "FRAGMENT");
+		m_FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(m_FragmentShaderID, 1, &m_FragmentShaderSource, NULL);
+		glCompileShader(m_FragmentShaderID);
 
 		// geometry shader
 		if (m_GeometryShaderSource != nullptr) {
-			geometryShader = glCreateShader(GL_GEOMETRY_SHADER);
-			glShaderSource(geometryShader, 1, &m_GeometryShaderSource, NULL);
-			glCompileShader(geometryShader);
-			checkCompileErrors(geometryShader, "GEOMETRY");
+			m_GeometryShaderID = glCreateShader(GL_GEOMETRY_SHADER);
+			glShaderSource(m_GeometryShaderID, 1, &m_GeometryShaderSource, NULL);
+			glCompileShader(m_GeometryShaderID);
 		}
 
 		// link shaders
 		shaderProgram = glCreateProgram();
-		glAttachShader(shaderProgram, vertexShader);
-		glAttachShader(shaderProgram, fragmentShader);
-		if (m_GeometryShaderSource != nullptr)
-			glAttachShader(shaderProgram, geometryShader);
+		glAttachShader(shaderProgram, m_VertexShaderID);
+		glAttachShader(shaderProgram, m_FragmentShaderID);
+		if (m_GeometryShaderID != 0)
+			glAttachShader(shaderProgram, m_GeometryShaderID);
+		glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glLinkProgram(shaderProgram);
-		checkCompileErrors(shaderProgram, "PROGRAM");
+
+		// return submitted shader program
+		return shaderProgram;
+	}
+
+	// checks the compile and link results once the driver is done, then builds the uniform table
+	// ------------------------------------------------------------------------------------------
+	void Shader::finalize()
+	{
+		if (m_Status != SHADER_PENDING)
+			return;
+
+		checkCompileErrors(m_VertexShaderID, "VERTEX");
+		checkCompileErrors(m_FragmentShaderID, "FRAGMENT");
+		if (m_GeometryShaderID != 0)
+			checkCompileErrors(m_GeometryShaderID, "GEOMETRY");
+
+		if (checkCompileErrors(m_ShaderID, "PROGRAM"))
+		{
+			m_Status = SHADER_READY;
+			ShaderCache::store(m_ShaderID, m_CacheKey);
+			buildUniformTable();
+		}
+		else
+			m_Status = SHADER_FAILED;
 
 		// delete shaders
-		glDeleteShader(vertexShader);
-		glDeleteShader(fragmentShader);
-		if (m_GeometryShaderSource != nullptr)
-			glDeleteShader(geometryShader);
+		glDeleteShader(m_VertexShaderID);
+		glDeleteShader(m_FragmentShaderID);
+		if (m_GeometryShaderID != 0)
+			glDeleteShader(m_GeometryShaderID);
+		m_VertexShaderID = m_FragmentShaderID = m_GeometryShaderID = 0;
+	}
 
-		// return linked shader program
-		return shaderProgram;
+	bool Shader::isReady()
+	{
+		if (m_Status == SHADER_PENDING)
+		{
+			if (GLExtensions::ParallelShaderCompile)
+			{
+				GLint completed = GL_FALSE;
+				glGetProgramiv(m_ShaderID, GL_COMPLETION_STATUS_KHR, &completed);
+				if (!completed)
+					return false;
+			}
+			finalize();
+		}
+		return m_Status == SHADER_READY;
+	}
+
+	void Shader::wait()
+	{
+		finalize();
 	}
 
-	void Shader::checkCompileErrors(GLuint shader, std::string shaderType)
+	bool Shader::checkCompileErrors(GLuint shader, std::string shaderType)
 	{
 		GLint success;
 		GLchar infoLog[1024];
@@ -114,80 +257,263 @@ namespace graphics {
 				std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << shaderType << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
 			}
 		}
+		return success == GL_TRUE;
 	}
 
 	// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 	// -------------------------------------------------------------------------------
 	void Shader::enable() const
 	{
-		glUseProgram(m_ShaderID);
+		GLState::useProgram(m_ShaderID);
 	}
 
 	// Check if Shader should be closed
 	// --------------------------------
 	void Shader::disable() const
 	{
-		glUseProgram(0);
+#if GLSTATE_UNBIND
+		GLState::useProgram(0);
+#endif
+	}
+
+	// uniform table
+	// ------------------------------------------------------------------------
+	// lists every active uniform of the linked program once and stores name -> location in a
+	// flat hash table, so the setters never go through glGetUniformLocation's string lookup.
+	void Shader::buildUniformTable()
+	{
+		m_Uniforms.clear();
+		m_UniformBuckets.clear();
+
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(m_ShaderID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(m_ShaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+		// first pass: collect every addressable name (array elements included) with its location
+		std::vector<std::string> names;
+		std::vector<char> buffer(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(m_ShaderID, i, (GLsizei)buffer.size(), NULL, &size, &type, &buffer[0]);
+			std::string name(&buffer[0]);
+			GLint location = glGetUniformLocation(m_ShaderID, name.c_str());
+			// members of uniform blocks have no location
+			if (location < 0)
+				continue;
+
+			UniformSlot slot;
+			slot.location = location;
+			slot.type = type;
+			slot.hasValue = false;
+			m_Uniforms.push_back(slot);
+			names.push_back(name);
+
+			// arrays of basic types are reported once as "name[0]" with their size
+			if (size > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+			{
+				std::string base = name.substr(0, name.size() - 3);
+				for (GLint e = 1; e < size; e++)
+				{
+					std::stringstream element;
+					element << base << "[" << e << "]";
+					slot.location = glGetUniformLocation(m_ShaderID, element.str().c_str());
+					m_Uniforms.push_back(slot);
+					names.push_back(element.str());
+				}
+			}
+		}
+
+		// second pass: power of two table at most half full
+		size_t capacity = 16;
+		while (capacity < m_Uniforms.size() * 2 + 2)
+			capacity <<= 1;
+		m_UniformBuckets.resize(capacity);
+		for (size_t i = 0; i < capacity; i++)
+			m_UniformBuckets[i].slot = -1;
+
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			insertUniform(names[i], (int)i);
+			// "name[0]" is also reachable as plain "name"
+			if (names[i].size() > 3 && names[i].compare(names[i].size() - 3, 3, "[0]") == 0)
+				insertUniform(names[i].substr(0, names[i].size() - 3), (int)i);
+		}
+	}
+
+	void Shader::insertUniform(const std::string &name, int slot)
+	{
+		unsigned int hash = hashName(name.c_str());
+		size_t mask = m_UniformBuckets.size() - 1;
+		for (size_t i = hash & mask; ; i = (i + 1) & mask)
+		{
+			UniformBucket& bucket = m_UniformBuckets[i];
+			if (bucket.slot < 0)
+			{
+				bucket.hash = hash;
+				bucket.slot = slot;
+				bucket.name = name;
+				return;
+			}
+			if (bucket.hash == hash && bucket.name == name)
+				return;
+		}
+	}
+
+	UniformHandle Shader::getUniformHandle(const char* name) const
+	{
+		if (m_UniformBuckets.empty())
+			return -1;
+		unsigned int hash = hashName(name);
+		size_t mask = m_UniformBuckets.size() - 1;
+		for (size_t i = hash & mask; ; i = (i + 1) & mask)
+		{
+			const UniformBucket& bucket = m_UniformBuckets[i];
+			if (bucket.slot < 0)
+				return -1;
+			if (bucket.hash == hash && std::strcmp(bucket.name.c_str(), name) == 0)
+				return bucket.slot;
+		}
+	}
+
+	// FNV-1a
+	unsigned int Shader::hashName(const char* name)
+	{
+		unsigned int hash = 2166136261u;
+		for (; *name; name++)
+		{
+			hash ^= (unsigned char)*name;
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	// returns true if the value differs from the last one uploaded and has to reach the driver
+	bool Shader::updateShadow(UniformHandle handle, const void* data, size_t size) const
+	{
+		if (handle < 0)
+			return false;
+		UniformSlot& slot = m_Uniforms[handle];
+		if (slot.hasValue && std::memcmp(slot.value, data, size) == 0)
+			return false;
+		std::memcpy(slot.value, data, size);
+		slot.hasValue = true;
+		return true;
 	}
 
 	// utility uniform functions
 	// ------------------------------------------------------------------------
 	void Shader::setBool(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(m_ShaderID, name.c_str()), (int)value);
+		setBool(getUniformHandle(name.c_str()), value);
 	}
 	// ------------------------------------------------------------------------
 	void Shader::setInt(const std::string &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(m_ShaderID, name.c_str()), value);
+		setInt(getUniformHandle(name.c_str()), value);
 	}
 	// ------------------------------------------------------------------------
 	void Shader::setFloat(const std::string &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(m_ShaderID, name.c_str()), value);
+		setFloat(getUniformHandle(name.c_str()), value);
 	}
 	// ------------------------------------------------------------------------
 	void Shader::setVec2(const std::string &name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, &value[0]);
+		setVec2(getUniformHandle(name.c_str()), value);
 	}
 	void Shader::setVec2(const std::string &name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(m_ShaderID, name.c_str()), x, y);
+		setVec2(getUniformHandle(name.c_str()), glm::vec2(x, y));
 	}
 	// ------------------------------------------------------------------------
 	void Shader::setVec3(const std::string &name, const glm::vec3 &value) const
 	{
-		glUniform3fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, &value[0]);
+		setVec3(getUniformHandle(name.c_str()), value);
 	}
 	void Shader::setVec3(const std::string &name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(m_ShaderID, name.c_str()), x, y, z);
+		setVec3(getUniformHandle(name.c_str()), glm::vec3(x, y, z));
 	}
 	// ------------------------------------------------------------------------
 	void Shader::setVec4(const std::string &name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, &value[0]);
+		setVec4(getUniformHandle(name.c_str()), value);
 	}
-	void Shader::setVec4(const std::string &name, float x, float y, float z, float w)
+	void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(m_ShaderID, name.c_str()), x, y, z, w);
+		setVec4(getUniformHandle(name.c_str()), glm::vec4(x, y, z, w));
 	}
 	// ------------------------------------------------------------------------
 	void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat2(getUniformHandle(name.c_str()), mat);
 	}
 	// ------------------------------------------------------------------------
 	void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat3(getUniformHandle(name.c_str()), mat);
 	}
 	// ------------------------------------------------------------------------
 	void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_ShaderID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat4(getUniformHandle(name.c_str()), mat);
 	}
 
+	// handle based uniform functions, skip the upload when the value is unchanged
+	// ------------------------------------------------------------------------
+	void Shader::setBool(UniformHandle handle, bool value) const
+	{
+		setInt(handle, (int)value);
+	}
+	// ------------------------------------------------------------------------
+	void Shader::setInt(UniformHandle handle, int value) const
+	{
+		if (updateShadow(handle, &value, sizeof(value)))
+			glUniform1i(m_Uniforms[handle].location, value);
+	}
+	// ------------------------------------------------------------------------
+	void Shader::setFloat(UniformHandle handle, float value) const
+	{
+		if (updateShadow(handle, &value, sizeof(value)))
+			glUniform1f(m_Uniforms[handle].location, value);
+	}
+	// ------------------------------------------------------------------------
+	void Shader::setVec2(UniformHandle handle, const glm::vec2 &value) const
+	{
+		if (updateShadow(handle, &value[0], sizeof(value)))
+			glUniform2fv(m_Uniforms[handle].location, 1, &value[0]);
+	}
+	// ------------------------------------------------------------------------
+	void Shader::setVec3(UniformHandle handle, const glm::vec3 &value) const
+	{
+		if (updateShadow(handle, &value[0], sizeof(value)))
+			glUniform3fv(m_Uniforms[handle].location, 1, &value[0]);
+	}
+	// ------------------------------------------------------------------------
+	void Shader::setVec4(UniformHandle handle, const glm::vec4 &value) const
+	{
+		if (updateShadow(handle, &value[0], sizeof(value)))
+			glUniform4fv(m_Uniforms[handle].location, 1, &value[0]);
+	}
+	// ------------------------------------------------------------------------
+	void Shader::setMat2(UniformHandle handle, const glm::mat2 &mat) const
+	{
+		if (updateShadow(handle, &mat[0][0], sizeof(mat)))
+			glUniformMatrix2fv(m_Uniforms[handle].location, 1, GL_FALSE, &mat[0][0]);
+	}
+	// ------------------------------------------------------------------------
+	void Shader::setMat3(UniformHandle handle, const glm::mat3 &mat) const
+	{
+		if (updateShadow(handle, &mat[0][0], sizeof(mat)))
+			glUniformMatrix3fv(m_Uniforms[handle].location, 1, GL_FALSE, &mat[0][0]);
+	}
+	// ------------------------------------------------------------------------
+	void Shader::setMat4(UniformHandle handle, const glm::mat4 &mat) const
+	{
+		if (updateShadow(handle, &mat[0][0], sizeof(mat)))
+			glUniformMatrix4fv(m_Uniforms[handle].location, 1, GL_FALSE, &mat[0][0]);
+	}
 
 }
\ No newline at end of file
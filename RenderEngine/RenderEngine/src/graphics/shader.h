@@ -5,24 +5,98 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstring>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 namespace graphics {
+
+	// index into a program's uniform table, -1 for uniforms the program doesn't use
+	typedef int UniformHandle;
+
+	// handle tagged with the uniform's C++ type, declared by the generated interfaces in
+	// shaderinterfaces.h so a type mismatch is a compile error rather than a GL error
+	template <typename T>
+	struct Uniform {
+		UniformHandle handle;
+		Uniform() : handle(-1) {}
+	};
+
+	enum ShaderStatus {
+		SHADER_PENDING,	// submitted to the driver, compile/link status not queried yet
+		SHADER_READY,
+		SHADER_FAILED
+	};
+
+	// set of preprocessor defines injected right after #version. Kept sorted by name so equal
+	// sets always produce the same key, whatever order they were set in.
+	class ShaderDefines
+	{
+	private:
+		std::vector<std::pair<std::string, std::string> > m_Defines;
+
+	public:
+		ShaderDefines& set(const std::string &name, const std::string &value = "1");
+		ShaderDefines& set(const std::string &name, int value);
+
+		// "#define NAME VALUE" lines, also used as the permutation key
+		std::string getSource() const;
+		// hash of the same lines without building them, for callers checking every frame
+		// whether a set changed
+		unsigned long long getHash() const;
+		inline bool empty() const { return m_Defines.empty(); }
+	};
+
 	class Shader
 	{
+	private:
+		// one active uniform location plus a shadow copy of the last value uploaded to it
+		struct UniformSlot {
+			GLint location;
+			GLenum type;
+			bool hasValue;
+			float value[16];
+		};
+
+		// open addressing bucket of the name -> slot table
+		struct UniformBucket {
+			unsigned int hash;
+			int slot;
+			std::string name;
+		};
+
 	private:
 		int m_ShaderID;
 		const char *m_VertexShaderSource;
 		const char *m_FragmentShaderSource;
 		const char *m_GeometryShaderSource;
 
+		// stages kept alive until the deferred status check
+		ShaderStatus m_Status;
+		int m_VertexShaderID, m_FragmentShaderID, m_GeometryShaderID;
+		unsigned long long m_CacheKey;
+		std::string m_Defines;
+
+		// uniform table built from program introspection after linking
+		mutable std::vector<UniformSlot> m_Uniforms;
+		std::vector<UniformBucket> m_UniformBuckets;
+
 	public:
-		Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
+		// with async set the stages are only submitted, compile and link finish in the background
+		// and isReady() reports when the program can be used
+		Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, bool async = false);
+		// compiles one permutation, the defines are injected into every stage
+		Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const ShaderDefines &defines, bool async = false);
 		~Shader();
 
+		// non-blocking with GL_KHR_parallel_shader_compile, otherwise finishes the program on the spot
+		bool isReady();
+		// blocks until the program is linked
+		void wait();
+
 		void enable() const;
 		void disable() const;
 
@@ -45,7 +119,7 @@ namespace graphics {
 
 		void setVec4(const std::string &name, const glm::vec4 &value) const;
 
-		void setVec4(const std::string &name, float x, float y, float z, float w);
+		void setVec4(const std::string &name, float x, float y, float z, float w) const;
 
 		void setMat2(const std::string &name, const glm::mat2 &mat) const;
 
@@ -53,15 +127,59 @@ namespace graphics {
 
 		void setMat4(const std::string &name, const glm::mat4 &mat) const;
 
+		// same setters with a handle resolved once through getUniformHandle()
+		// ------------------------------------------------------------------------
+		void setBool(UniformHandle handle, bool value) const;
+
+		void setInt(UniformHandle handle, int value) const;
+
+		void setFloat(UniformHandle handle, float value) const;
+
+		void setVec2(UniformHandle handle, const glm::vec2 &value) const;
+
+		void setVec3(UniformHandle handle, const glm::vec3 &value) const;
+
+		void setVec4(UniformHandle handle, const glm::vec4 &value) const;
+
+		void setMat2(UniformHandle handle, const glm::mat2 &mat) const;
+
+		void setMat3(UniformHandle handle, const glm::mat3 &mat) const;
+
+		void setMat4(UniformHandle handle, const glm::mat4 &mat) const;
+
+		// typed handles from shaderinterfaces.h
+		// ------------------------------------------------------------------------
+		inline void set(const Uniform<bool> &uniform, bool value) const { setBool(uniform.handle, value); }
+		inline void set(const Uniform<int> &uniform, int value) const { setInt(uniform.handle, value); }
+		inline void set(const Uniform<float> &uniform, float value) const { setFloat(uniform.handle, value); }
+		inline void set(const Uniform<glm::vec2> &uniform, const glm::vec2 &value) const { setVec2(uniform.handle, value); }
+		inline void set(const Uniform<glm::vec3> &uniform, const glm::vec3 &value) const { setVec3(uniform.handle, value); }
+		inline void set(const Uniform<glm::vec4> &uniform, const glm::vec4 &value) const { setVec4(uniform.handle, value); }
+		inline void set(const Uniform<glm::mat2> &uniform, const glm::mat2 &mat) const { setMat2(uniform.handle, mat); }
+		inline void set(const Uniform<glm::mat3> &uniform, const glm::mat3 &mat) const { setMat3(uniform.handle, mat); }
+		inline void set(const Uniform<glm::mat4> &uniform, const glm::mat4 &mat) const { setMat4(uniform.handle, mat); }
+
 
 		// getter
 		// ------------------------------------------------------------------------
 
 		int getShaderID() const { return m_ShaderID; }
+		ShaderStatus getStatus() const { return m_Status; }
+
+		// looks a uniform up in the program's table, returns -1 if it isn't active
+		UniformHandle getUniformHandle(const char* name) const;
+		inline UniformHandle getUniformHandle(const std::string &name) const { return getUniformHandle(name.c_str()); }
 
 	private:
 		std::string readFile(const char* shaderPath, std::string shaderType);
-		void checkCompileErrors(GLuint shader, std::string shaderType);
+		std::string injectDefines(const std::string &source) const;
+		bool checkCompileErrors(GLuint shader, std::string shaderType);
 		int load();
+		void finalize();
+
+		void buildUniformTable();
+		void insertUniform(const std::string &name, int slot);
+		bool updateShadow(UniformHandle handle, const void* data, size_t size) const;
+		static unsigned int hashName(const char* name);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "shadercache.h"
+
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace graphics {
+
+	// file header written in front of every cached binary
+	struct ShaderCacheHeader {
+		unsigned int magic;
+		unsigned int format;
+		unsigned long long key;
+		unsigned int length;
+	};
+
+	static const unsigned int SHADER_CACHE_MAGIC = 0x42535245; // "ERSB"
+
+	std::string ShaderCache::s_Directory = "shadercache";
+	bool ShaderCache::s_Enabled = true;
+	bool ShaderCache::s_Initialized = false;
+	unsigned int ShaderCache::s_Hits = 0;
+	unsigned int ShaderCache::s_Misses = 0;
+	unsigned int ShaderCache::s_Rejected = 0;
+
+	void ShaderCache::setDirectory(const std::string &directory)
+	{
+		s_Directory = directory;
+		s_Initialized = false;
+	}
+
+	void ShaderCache::setEnabled(bool enabled)
+	{
+		s_Enabled = enabled;
+	}
+
+	// the cache needs at least one binary format and a directory to live in
+	// ----------------------------------------------------------------------
+	bool ShaderCache::init()
+	{
+		if (s_Initialized)
+			return s_Enabled;
+		s_Initialized = true;
+
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (formats == 0)
+		{
+			std::cout << "SHADER_CACHE::NO_PROGRAM_BINARY_FORMATS, caching disabled" << std::endl;
+			s_Enabled = false;
+			return false;
+		}
+#ifdef _WIN32
+		_mkdir(s_Directory.c_str());
+#else
+		mkdir(s_Directory.c_str(), 0755);
+#endif
+		return s_Enabled;
+	}
+
+	// FNV-1a 64
+	unsigned long long ShaderCache::hash(unsigned long long hash, const char* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= (unsigned char)data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	unsigned long long ShaderCache::computeKey(const std::vector<const char*> &sources, const std::string &defines)
+	{
+		unsigned long long key = 14695981039346656037ull;
+		const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (GLenum name : driverStrings)
+		{
+			const char* value = (const char*)glGetString(name);
+			if (value != nullptr)
+				key = hash(key, value, std::strlen(value) + 1);
+		}
+		key = hash(key, defines.c_str(), defines.size() + 1);
+		for (const char* source : sources)
+		{
+			// absent stages still change the key so vs+fs and vs+gs+fs never collide
+			if (source != nullptr)
+				key = hash(key, source, std::strlen(source) + 1);
+			else
+				key = hash(key, "", 1);
+		}
+		return key;
+	}
+
+	std::string ShaderCache::getFilePath(unsigned long long key)
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.bin", key);
+		return s_Directory + "/" + name;
+	}
+
+	bool ShaderCache::load(GLuint program, unsigned long long key)
+	{
+		if (!init())
+			return false;
+
+		std::ifstream file(getFilePath(key).c_str(), std::ios::binary);
+		ShaderCacheHeader header;
+		if (!file || !file.read((char*)&header, sizeof(header)) || header.magic != SHADER_CACHE_MAGIC || header.key != key)
+		{
+			s_Misses++;
+			return false;
+		}
+		std::vector<char> binary(header.length);
+		if (header.length == 0 || !file.read(&binary[0], header.length))
+		{
+			s_Misses++;
+			return false;
+		}
+
+		// the driver may reject a binary it produced itself (e.g. after an update), treat it as a miss
+		glProgramBinary(program, header.format, &binary[0], header.length);
+		GLint success = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			s_Rejected++;
+			s_Misses++;
+			return false;
+		}
+		s_Hits++;
+		return true;
+	}
+
+	void ShaderCache::store(GLuint program, unsigned long long key)
+	{
+		if (!init())
+			return;
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		ShaderCacheHeader header;
+		header.magic = SHADER_CACHE_MAGIC;
+		header.key = key;
+		std::vector<char> binary(length);
+		GLsizei written = 0;
+		glGetProgramBinary(program, length, &written, &header.format, &binary[0]);
+		header.length = written;
+
+		std::ofstream file(getFilePath(key).c_str(), std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::cout << "SHADER_CACHE::FILE_NOT_SUCCESFULLY_WRITTEN " << getFilePath(key) << std::endl;
+			return;
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write(&binary[0], written);
+	}
+
+	void ShaderCache::printStats()
+	{
+		std::cout << "Shader cache: " << s_Hits << " hits, " << s_Misses << " misses (" << s_Rejected << " rejected by the driver)" << std::endl;
+	}
+}
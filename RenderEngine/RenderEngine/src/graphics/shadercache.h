@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace graphics {
+
+	// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+	// Entries are keyed by a hash of the GLSL sources, the defines and the driver's
+	// vendor/renderer/version strings, so a driver update or an edited shader simply misses.
+	class ShaderCache
+	{
+	private:
+		static std::string s_Directory;
+		static bool s_Enabled;
+		static bool s_Initialized;
+		static unsigned int s_Hits;
+		static unsigned int s_Misses;
+		static unsigned int s_Rejected;
+
+	public:
+		static void setDirectory(const std::string &directory);
+		static void setEnabled(bool enabled);
+
+		static unsigned long long computeKey(const std::vector<const char*> &sources, const std::string &defines);
+
+		// tries to load the cached binary into program, returns false when the caller has to compile
+		static bool load(GLuint program, unsigned long long key);
+		// stores the binary of a successfully linked program
+		static void store(GLuint program, unsigned long long key);
+
+		inline static unsigned int getHits() { return s_Hits; }
+		inline static unsigned int getMisses() { return s_Misses; }
+		inline static unsigned int getRejected() { return s_Rejected; }
+		static void printStats();
+
+	private:
+		static bool init();
+		static std::string getFilePath(unsigned long long key);
+		static unsigned long long hash(unsigned long long hash, const char* data, size_t size);
+	};
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+// Generated by tools/shaderinterface.py from resources/shaders, do not edit.
+// Re-run the script after changing a uniform; code using a renamed or removed
+// uniform then fails to compile instead of silently setting nothing.
+
+#include <cstddef>
+
+#include "shader.h"
+#include "uniformblocks.h"
+
+namespace graphics {
+	namespace shaders {
+
+		// ShadowDepth program, default block uniforms
+		struct ShadowDepthInterface
+		{
+			Uniform<glm::mat4> lightViewProjection;
+
+			// program the handles were resolved for
+			const Shader* program;
+
+			ShadowDepthInterface() : program(nullptr) {}
+
+			// looks every handle up once, a no-op while the program stays the same
+			void resolve(const Shader* shader)
+			{
+				if (shader == program)
+					return;
+				program = shader;
+				lightViewProjection.handle = shader->getUniformHandle("lightViewProjection");
+			}
+		};
+
+		// PointShadow program, default block uniforms
+		struct PointShadowInterface
+		{
+			Uniform<glm::mat4> faceViewProjection[6];
+			Uniform<int> faceMask;
+			Uniform<glm::vec4> lightPositionRadius;
+
+			// program the handles were resolved for
+			const Shader* program;
+
+			PointShadowInterface() : program(nullptr) {}
+
+			// looks every handle up once, a no-op while the program stays the same
+			void resolve(const Shader* shader)
+			{
+				if (shader == program)
+					return;
+				program = shader;
+				faceViewProjection[0].handle = shader->getUniformHandle("faceViewProjection[0]");
+				faceViewProjection[1].handle = shader->getUniformHandle("faceViewProjection[1]");
+				faceViewProjection[2].handle = shader->getUniformHandle("faceViewProjection[2]");
+				faceViewProjection[3].handle = shader->getUniformHandle("faceViewProjection[3]");
+				faceViewProjection[4].handle = shader->getUniformHandle("faceViewProjection[4]");
+				faceViewProjection[5].handle = shader->getUniformHandle("faceViewProjection[5]");
+				faceMask.handle = shader->getUniformHandle("faceMask");
+				lightPositionRadius.handle = shader->getUniformHandle("lightPositionRadius");
+			}
+		};
+
+		// std140 uniform blocks, offsets in bytes
+
+		struct CameraLayout
+		{
+			static const unsigned int binding = 0;
+			static const unsigned int size = 144;
+			static const unsigned int view = 0;
+			static const unsigned int projection = 64;
+			static const unsigned int viewPos = 128;
+		};
+
+		struct LightsLayout
+		{
+			static const unsigned int binding = 1;
+			static const unsigned int size = 160;
+			static const unsigned int dirLight = 0;
+			static const unsigned int spotLight = 64;
+			static const unsigned int pointLightCount = 144;
+		};
+
+		struct DirLightLayout
+		{
+			static const unsigned int size = 64;
+			static const unsigned int direction = 0;
+			static const unsigned int ambient = 16;
+			static const unsigned int diffuse = 32;
+			static const unsigned int specular = 48;
+		};
+
+		struct SpotLightLayout
+		{
+			static const unsigned int size = 80;
+			static const unsigned int position = 0;
+			static const unsigned int constant = 12;
+			static const unsigned int direction = 16;
+			static const unsigned int linear = 28;
+			static const unsigned int ambient = 32;
+			static const unsigned int quadratic = 44;
+			static const unsigned int diffuse = 48;
+			static const unsigned int cutOff = 60;
+			static const unsigned int specular = 64;
+			static const unsigned int outerCutOff = 76;
+		};
+
+		struct ClustersLayout
+		{
+			static const unsigned int binding = 3;
+			static const unsigned int size = 32;
+			static const unsigned int clusterGrid = 0;
+			static const unsigned int clusterParams = 16;
+		};
+
+		struct ShadowsLayout
+		{
+			static const unsigned int binding = 5;
+			static const unsigned int size = 304;
+			static const unsigned int cascadeViewProjection = 0;
+			static const unsigned int cascadeViewProjectionStride = 64;
+			static const unsigned int cascadeSplits = 256;
+			static const unsigned int cascadeTexelSize = 272;
+			static const unsigned int shadowParams = 288;
+		};
+
+		struct DeferredLayout
+		{
+			static const unsigned int binding = 4;
+			static const unsigned int size = 80;
+			static const unsigned int invViewProjection = 0;
+			static const unsigned int screenSize = 64;
+		};
+	}
+
+	// the C++ mirrors have to follow the GLSL blocks byte for byte
+	static_assert(sizeof(CameraBlock) == shaders::CameraLayout::size, "CameraBlock doesn't match GLSL Camera");
+	static_assert(CAMERA_BLOCK_BINDING == shaders::CameraLayout::binding, "CAMERA_BLOCK_BINDING doesn't match the GLSL Camera binding");
+	static_assert(offsetof(CameraBlock, view) == shaders::CameraLayout::view, "CameraBlock::view is misplaced");
+	static_assert(offsetof(CameraBlock, projection) == shaders::CameraLayout::projection, "CameraBlock::projection is misplaced");
+	static_assert(offsetof(CameraBlock, viewPos) == shaders::CameraLayout::viewPos, "CameraBlock::viewPos is misplaced");
+	static_assert(sizeof(LightsBlock) == shaders::LightsLayout::size, "LightsBlock doesn't match GLSL Lights");
+	static_assert(LIGHTS_BLOCK_BINDING == shaders::LightsLayout::binding, "LIGHTS_BLOCK_BINDING doesn't match the GLSL Lights binding");
+	static_assert(offsetof(LightsBlock, dirLight) == shaders::LightsLayout::dirLight, "LightsBlock::dirLight is misplaced");
+	static_assert(offsetof(LightsBlock, spotLight) == shaders::LightsLayout::spotLight, "LightsBlock::spotLight is misplaced");
+	static_assert(offsetof(LightsBlock, pointLightCount) == shaders::LightsLayout::pointLightCount, "LightsBlock::pointLightCount is misplaced");
+	static_assert(sizeof(DirLightData) == shaders::DirLightLayout::size, "DirLightData doesn't match GLSL DirLight");
+	static_assert(offsetof(DirLightData, direction) == shaders::DirLightLayout::direction, "DirLightData::direction is misplaced");
+	static_assert(offsetof(DirLightData, ambient) == shaders::DirLightLayout::ambient, "DirLightData::ambient is misplaced");
+	static_assert(offsetof(DirLightData, diffuse) == shaders::DirLightLayout::diffuse, "DirLightData::diffuse is misplaced");
+	static_assert(offsetof(DirLightData, specular) == shaders::DirLightLayout::specular, "DirLightData::specular is misplaced");
+	static_assert(sizeof(SpotLightData) == shaders::SpotLightLayout::size, "SpotLightData doesn't match GLSL SpotLight");
+	static_assert(offsetof(SpotLightData, position) == shaders::SpotLightLayout::position, "SpotLightData::position is misplaced");
+	static_assert(offsetof(SpotLightData, constant) == shaders::SpotLightLayout::constant, "SpotLightData::constant is misplaced");
+	static_assert(offsetof(SpotLightData, direction) == shaders::SpotLightLayout::direction, "SpotLightData::direction is misplaced");
+	static_assert(offsetof(SpotLightData, linear) == shaders::SpotLightLayout::linear, "SpotLightData::linear is misplaced");
+	static_assert(offsetof(SpotLightData, ambient) == shaders::SpotLightLayout::ambient, "SpotLightData::ambient is misplaced");
+	static_assert(offsetof(SpotLightData, quadratic) == shaders::SpotLightLayout::quadratic, "SpotLightData::quadratic is misplaced");
+	static_assert(offsetof(SpotLightData, diffuse) == shaders::SpotLightLayout::diffuse, "SpotLightData::diffuse is misplaced");
+	static_assert(offsetof(SpotLightData, cutOff) == shaders::SpotLightLayout::cutOff, "SpotLightData::cutOff is misplaced");
+	static_assert(offsetof(SpotLightData, specular) == shaders::SpotLightLayout::specular, "SpotLightData::specular is misplaced");
+	static_assert(offsetof(SpotLightData, outerCutOff) == shaders::SpotLightLayout::outerCutOff, "SpotLightData::outerCutOff is misplaced");
+	static_assert(sizeof(ClusterBlock) == shaders::ClustersLayout::size, "ClusterBlock doesn't match GLSL Clusters");
+	static_assert(CLUSTER_BLOCK_BINDING == shaders::ClustersLayout::binding, "CLUSTER_BLOCK_BINDING doesn't match the GLSL Clusters binding");
+	static_assert(offsetof(ClusterBlock, clusterGrid) == shaders::ClustersLayout::clusterGrid, "ClusterBlock::clusterGrid is misplaced");
+	static_assert(offsetof(ClusterBlock, clusterParams) == shaders::ClustersLayout::clusterParams, "ClusterBlock::clusterParams is misplaced");
+	static_assert(sizeof(ShadowBlock) == shaders::ShadowsLayout::size, "ShadowBlock doesn't match GLSL Shadows");
+	static_assert(SHADOW_BLOCK_BINDING == shaders::ShadowsLayout::binding, "SHADOW_BLOCK_BINDING doesn't match the GLSL Shadows binding");
+	static_assert(offsetof(ShadowBlock, cascadeViewProjection) == shaders::ShadowsLayout::cascadeViewProjection, "ShadowBlock::cascadeViewProjection is misplaced");
+	static_assert(offsetof(ShadowBlock, cascadeSplits) == shaders::ShadowsLayout::cascadeSplits, "ShadowBlock::cascadeSplits is misplaced");
+	static_assert(offsetof(ShadowBlock, cascadeTexelSize) == shaders::ShadowsLayout::cascadeTexelSize, "ShadowBlock::cascadeTexelSize is misplaced");
+	static_assert(offsetof(ShadowBlock, shadowParams) == shaders::ShadowsLayout::shadowParams, "ShadowBlock::shadowParams is misplaced");
+	static_assert(sizeof(DeferredBlock) == shaders::DeferredLayout::size, "DeferredBlock doesn't match GLSL Deferred");
+	static_assert(DEFERRED_BLOCK_BINDING == shaders::DeferredLayout::binding, "DEFERRED_BLOCK_BINDING doesn't match the GLSL Deferred binding");
+	static_assert(offsetof(DeferredBlock, invViewProjection) == shaders::DeferredLayout::invViewProjection, "DeferredBlock::invViewProjection is misplaced");
+	static_assert(offsetof(DeferredBlock, screenSize) == shaders::DeferredLayout::screenSize, "DeferredBlock::screenSize is misplaced");
+}
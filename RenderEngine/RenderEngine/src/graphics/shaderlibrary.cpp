@@ -0,0 +1,29 @@
+#include "shaderlibrary.h"
+
+namespace graphics {
+
+	ShaderLibrary::ShaderLibrary(const char* vertexPath, const char* fragmentPath, const char* geometryPath, bool async)
+		: m_VertexPath(vertexPath), m_FragmentPath(fragmentPath), m_GeometryPath(geometryPath != nullptr ? geometryPath : ""), m_Async(async)
+	{
+	}
+
+	ShaderLibrary::~ShaderLibrary()
+	{
+		for (std::map<std::string, Shader*>::iterator it = m_Permutations.begin(); it != m_Permutations.end(); ++it)
+			delete it->second;
+	}
+
+	// returns the permutation for this set of defines, compiling it on first use
+	Shader* ShaderLibrary::get(const ShaderDefines &defines)
+	{
+		std::string key = defines.getSource();
+		std::map<std::string, Shader*>::iterator it = m_Permutations.find(key);
+		if (it != m_Permutations.end())
+			return it->second;
+
+		Shader* shader = new Shader(m_VertexPath.c_str(), m_FragmentPath.c_str(),
+			m_GeometryPath.empty() ? nullptr : m_GeometryPath.c_str(), defines, m_Async);
+		m_Permutations[key] = shader;
+		return shader;
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "shader.h"
+
+#include <string>
+#include <map>
+
+namespace graphics {
+
+	// All compiled permutations of one program. Each unique set of defines is compiled once
+	// and handed out again on every later request with the same set.
+	class ShaderLibrary
+	{
+	private:
+		std::string m_VertexPath;
+		std::string m_FragmentPath;
+		std::string m_GeometryPath;
+		bool m_Async;
+		std::map<std::string, Shader*> m_Permutations;
+
+	public:
+		ShaderLibrary(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, bool async = false);
+		~ShaderLibrary();
+
+		Shader* get(const ShaderDefines &defines);
+
+		inline unsigned int getPermutationCount() const { return (unsigned int)m_Permutations.size(); }
+	};
+}
@@ -0,0 +1,281 @@
+#include "cascadedshadowmap.h"
+#include "../glstate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace graphics {
+
+	CascadedShadowMap::CascadedShadowMap(unsigned int resolution, float shadowDistance, bool async, VertexFormat format)
+		:m_Resolution(resolution), m_ShadowDistance(shadowDistance), m_CasterDistance(50.0f), m_EveryFrameCascades(2), m_SnapTexels(64),
+		m_Frame(0), m_LastView(1.0f), m_CameraMoving(false)
+	{
+		// hardware depth compare with linear filtering gives a 2x2 PCF per lookup. Outside the
+		// border the depth is 1, so nothing beyond a cascade is shadowed. The static array is
+		// only ever copied from, it gets the same storage so whole layers can be copied
+		unsigned int* textures[2] = { &m_DepthID, &m_StaticID };
+		for (int i = 0; i < 2; i++)
+		{
+			glGenTextures(1, textures[i]);
+			GLState::bindTexture(0, GL_TEXTURE_2D_ARRAY, *textures[i]);
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, m_Resolution, m_Resolution, SHADOW_CASCADES);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+			float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		}
+
+		// attached as a whole once so every cascade starts out unshadowed, later one layer at a time
+		glGenFramebuffers(1, &m_FramebufferID);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_FramebufferID);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		GLState::setDepthMask(true);
+		for (int i = 0; i < 2; i++)
+		{
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, *textures[i], 0);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+				std::cout << "ERROR::CASCADEDSHADOWMAP::FRAMEBUFFER_INCOMPLETE" << std::endl;
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		ShaderDefines defines;
+		defines.set("COMPACT_VERTICES", format == COMPACT_VERTICES ? 1 : 0);
+		m_DepthShader = new Shader("resources/shaders/shadow_depth.vs", "resources/shaders/shadow_depth.fs", nullptr, defines, async);
+
+		for (unsigned int c = 0; c < SHADOW_CASCADES; c++)
+		{
+			m_Rendered[c] = false;
+			m_Pending[c] = false;
+			m_StaticValid[c] = false;
+			m_Stale[c] = false;
+			m_Committed[c] = false;
+			m_DynamicDrawn[c] = false;
+			m_Block.cascadeViewProjection[c] = glm::mat4(1.0f);
+		}
+		m_Block.cascadeSplits = glm::vec4(0.0f);
+		m_Block.cascadeTexelSize = glm::vec4(0.0f);
+		m_Block.shadowParams = glm::vec4(1.5f, 0.0005f, 1.0f / m_Resolution, 0.0f);
+	}
+
+	CascadedShadowMap::~CascadedShadowMap()
+	{
+		delete m_DepthShader;
+		glDeleteFramebuffers(1, &m_FramebufferID);
+		GLState::deleteTexture(m_DepthID);
+		GLState::deleteTexture(m_StaticID);
+	}
+
+	void CascadedShadowMap::update(const glm::mat4 &view, float fovY, float aspect, float nearPlane, float farPlane, const glm::vec3 &lightDirection)
+	{
+		m_Frame++;
+		m_CameraMoving = view != m_LastView;
+		m_LastView = view;
+		glm::mat4 invView = glm::inverse(view);
+		float shadowFar = std::min(farPlane, m_ShadowDistance);
+
+		// split between logarithmic (even texel density) and uniform (no tiny first cascade)
+		const float lambda = 0.75f;
+		float sliceNear = nearPlane;
+		for (unsigned int c = 0; c < SHADOW_CASCADES; c++)
+		{
+			float p = (c + 1) / (float)SHADOW_CASCADES;
+			float logSplit = nearPlane * std::pow(shadowFar / nearPlane, p);
+			float uniformSplit = nearPlane + (shadowFar - nearPlane) * p;
+			float sliceFar = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+			m_Block.cascadeSplits[c] = sliceFar;
+
+			// far cascades alternate, a cascade that never rendered is always due
+			bool due = c < m_EveryFrameCascades || !m_Rendered[c] || (c - m_EveryFrameCascades) % 2 == m_Frame % 2;
+			m_Pending[c] = due;
+			if (due)
+				m_PendingViewProjection[c] = fitCascade(invView, fovY, aspect, sliceNear, sliceFar, lightDirection, m_PendingTexelSize[c], m_PendingOrigin[c]);
+			sliceNear = sliceFar;
+		}
+	}
+
+	bool CascadedShadowMap::beginCascade(unsigned int cascade, ShadowCasters casters)
+	{
+		if (!m_Pending[cascade] || !m_DepthShader->isReady())
+			return false;
+		const glm::mat4 &viewProjection = m_PendingViewProjection[cascade];
+		m_Committed[cascade] = true;
+		m_Rendered[cascade] = true;
+		m_Block.cascadeViewProjection[cascade] = viewProjection;
+		m_Block.cascadeTexelSize[cascade] = m_PendingTexelSize[cascade];
+
+		if (casters == STATIC_CASTERS)
+		{
+			if (m_StaticValid[cascade] && m_StaticOrigin[cascade] == m_PendingOrigin[cascade])
+			{
+				m_Stats[cascade].hits++;
+				if (m_CameraMoving)
+					m_MovingStats[cascade].hits++;
+				return false;
+			}
+			m_Stats[cascade].misses++;
+			if (m_CameraMoving)
+				m_MovingStats[cascade].misses++;
+			m_StaticValid[cascade] = true;
+			m_StaticViewProjection[cascade] = viewProjection;
+			m_StaticOrigin[cascade] = m_PendingOrigin[cascade];
+			m_Stale[cascade] = true;
+			bindLayer(m_StaticID, cascade, viewProjection);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			return true;
+		}
+
+		// dynamic casters on top of the static ones
+		if (m_Stale[cascade])
+			copyStatic(cascade);
+		m_Stale[cascade] = true;
+		m_DynamicDrawn[cascade] = true;
+		bindLayer(m_DepthID, cascade, viewProjection);
+		return true;
+	}
+
+	void CascadedShadowMap::endCascades(unsigned int width, unsigned int height)
+	{
+		for (unsigned int c = 0; c < SHADOW_CASCADES; c++)
+		{
+			// without a dynamic pass the sampled layer is the static one, copied only when it changed
+			if (m_Committed[c] && !m_DynamicDrawn[c] && m_Stale[c])
+			{
+				copyStatic(c);
+				m_Stale[c] = false;
+			}
+			m_Pending[c] = false;
+			m_Committed[c] = false;
+			m_DynamicDrawn[c] = false;
+		}
+
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glDisable(GL_DEPTH_CLAMP);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width, height);
+	}
+
+	void CascadedShadowMap::invalidate(const glm::vec3 &center, float radius)
+	{
+		// casters anywhere along the light direction can reach a cascade, only the extent
+		// across it matters. Light space x and y are -1..1 over 2 * cascade radius
+		for (unsigned int c = 0; c < SHADOW_CASCADES; c++)
+		{
+			if (!m_StaticValid[c])
+				continue;
+			glm::vec4 clip = m_StaticViewProjection[c] * glm::vec4(center, 1.0f);
+			float reach = 1.0f + radius * glm::length(glm::vec3(m_StaticViewProjection[c][0][0], m_StaticViewProjection[c][1][0], m_StaticViewProjection[c][2][0]));
+			if (std::abs(clip.x) <= reach && std::abs(clip.y) <= reach)
+				m_StaticValid[c] = false;
+		}
+	}
+
+	void CascadedShadowMap::invalidateAll()
+	{
+		for (unsigned int c = 0; c < SHADOW_CASCADES; c++)
+			m_StaticValid[c] = false;
+	}
+
+	void CascadedShadowMap::printStats() const
+	{
+		std::cout << "Cascade static cache hits:";
+		for (unsigned int c = 0; c < SHADOW_CASCADES; c++)
+			std::cout << " " << c << ": " << m_Stats[c].hitRate() << "%";
+		std::cout << ", while the camera moves:";
+		for (unsigned int c = 0; c < SHADOW_CASCADES; c++)
+			std::cout << " " << c << ": " << m_MovingStats[c].hitRate() << "% of " << m_MovingStats[c].hits + m_MovingStats[c].misses;
+		std::cout << std::endl;
+	}
+
+	void CascadedShadowMap::bindLayer(unsigned int texture, unsigned int cascade, const glm::mat4 &viewProjection)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_FramebufferID);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, cascade);
+		glViewport(0, 0, m_Resolution, m_Resolution);
+		GLState::setDepthMask(true);
+		GLState::setDepthTest(true);
+		GLState::setDepthFunc(GL_LESS);
+		GLState::setBlend(false);
+		// casters between the light and the cascade are clamped to its near plane instead of
+		// clipped, the slope scaled offset keeps lit surfaces from shadowing themselves
+		glEnable(GL_DEPTH_CLAMP);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(2.0f, 4.0f);
+
+		m_DepthShader->enable();
+		m_DepthInterface.resolve(m_DepthShader);
+		m_DepthShader->set(m_DepthInterface.lightViewProjection, viewProjection);
+	}
+
+	void CascadedShadowMap::copyStatic(unsigned int cascade)
+	{
+		glCopyImageSubData(m_StaticID, GL_TEXTURE_2D_ARRAY, 0, 0, 0, cascade,
+			m_DepthID, GL_TEXTURE_2D_ARRAY, 0, 0, 0, cascade, m_Resolution, m_Resolution, 1);
+	}
+
+	void CascadedShadowMap::bindForReading(RingBuffer* constants) const
+	{
+		GLState::bindTexture(SHADOW_CASCADE_UNIT, GL_TEXTURE_2D_ARRAY, m_DepthID);
+		int offset = constants->push(&m_Block, sizeof(ShadowBlock));
+		if (offset >= 0)
+			constants->bindRange(SHADOW_BLOCK_BINDING, offset, sizeof(ShadowBlock));
+	}
+
+	glm::mat4 CascadedShadowMap::fitCascade(const glm::mat4 &invView, float fovY, float aspect, float sliceNear, float sliceFar, const glm::vec3 &lightDirection, float &texelSize, CascadeOrigin &origin) const
+	{
+		// bounding sphere of the slice. Centered on the view axis its radius only depends on the
+		// split distances, so the cascade keeps its size however the camera turns
+		float tanY = std::tan(fovY * 0.5f);
+		float tanX = tanY * aspect;
+		glm::vec3 corners[8];
+		for (int i = 0; i < 8; i++)
+		{
+			float z = (i & 4) ? sliceFar : sliceNear;
+			glm::vec3 corner((i & 1 ? 1.0f : -1.0f) * z * tanX, (i & 2 ? 1.0f : -1.0f) * z * tanY, -z);
+			corners[i] = glm::vec3(invView * glm::vec4(corner, 1.0f));
+		}
+		glm::vec3 center(0.0f);
+		for (int i = 0; i < 8; i++)
+			center += corners[i];
+		center /= 8.0f;
+		float radius = 0.0f;
+		for (int i = 0; i < 8; i++)
+			radius = std::max(radius, glm::length(corners[i] - center));
+		// quantized, float noise in the corners would otherwise change the texel size
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		// light space rotated with the light around the world origin, it doesn't follow the camera
+		glm::vec3 direction = glm::normalize(lightDirection);
+		glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+		glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+
+		// the resolution minus one snap step covers the slice, the center is off by half a step at most
+		int halfResolution = (int)m_Resolution / 2;
+		texelSize = 2.0f * radius / (m_Resolution - m_SnapTexels);
+		float step = texelSize * m_SnapTexels;
+		origin.x = (int)std::floor(lightCenter.x / step + 0.5f);
+		origin.y = (int)std::floor(lightCenter.y / step + 0.5f);
+		// distance along the light, the view looks down -z. The slice's center lies in
+		// [depth, depth + 1) radii, the range reaches a radius past both ends plus the casters
+		origin.depth = (int)std::floor(-lightCenter.z / radius);
+		origin.radius = radius;
+		origin.direction = direction;
+
+		// built from the integers alone, the same origin gives the same matrix bit for bit
+		float left = origin.x * step - halfResolution * texelSize;
+		float bottom = origin.y * step - halfResolution * texelSize;
+		float right = origin.x * step + halfResolution * texelSize;
+		float top = origin.y * step + halfResolution * texelSize;
+		float nearDistance = (origin.depth - 1) * radius - m_CasterDistance;
+		float farDistance = (origin.depth + 2) * radius;
+		glm::mat4 lightProjection = glm::ortho(left, right, bottom, top, nearDistance, farDistance);
+		return lightProjection * lightView;
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <iostream>
+
+#include "../shader.h"
+#include "../shaderinterfaces.h"
+#include "../uniformblocks.h"
+#include "../buffers/ringbuffer.h"
+#include "../buffers/geometrypool.h"
+#include "shadowcache.h"
+
+namespace graphics {
+
+	// texture unit model.fs and deferred_light.fs sample the cascades from, above the material units
+	enum ShadowUnit {
+		SHADOW_CASCADE_UNIT = 8
+	};
+
+	// Cascaded shadow map of the directional light. The camera frustum up to the shadow distance
+	// is split into SHADOW_CASCADES slices, each rendered into one layer of a depth texture array.
+	// Every cascade is fitted around the bounding sphere of its slice, so its size doesn't change
+	// when the camera turns. It lives in a light space anchored at the world origin: across the
+	// light its center is snapped to steps of whole texels, so the shadow edges don't swim when
+	// the camera moves, and along the light its depth range to steps of the cascade radius. The
+	// cascade is a function of these integers, its CascadeOrigin. Casters are drawn position only
+	// with shadow_depth.vs.
+	//
+	// The near cascades are updated every frame, the far ones take turns: each is updated every
+	// other frame and keeps its last matrix in between, so receivers always sample a cascade with
+	// the matrix it was rendered with.
+	//
+	// Static casters are kept in a second texture array. An update only redraws a cascade's
+	// static layer when its origin changed or invalidate() touched it, otherwise the layer is
+	// copied under the dynamic casters as is. The snap step across the light is
+	// setSnapTexels() texels and the cascade is widened by half a step to still cover its slice,
+	// so the camera can move that far before a layer is redrawn, at the cost of that many texels
+	// of resolution.
+	//
+	// per frame:
+	//   update(...)
+	//   for every cascade:
+	//     if (beginCascade(c, STATIC_CASTERS)) { draw static casters with Model::DrawDepth }
+	//     if (beginCascade(c, DYNAMIC_CASTERS)) { draw dynamic casters }
+	//   endCascades(...)
+	//   bindForReading(constants) before the lit passes
+	class CascadedShadowMap
+	{
+	private:
+		// where a cascade sits in the world anchored light space, equal origins give the same matrix
+		struct CascadeOrigin {
+			int x, y;		// center across the light, in snap steps
+			int depth;		// start of the depth range along the light, in radii
+			float radius;
+			glm::vec3 direction;
+
+			inline bool operator==(const CascadeOrigin &other) const
+			{
+				return x == other.x && y == other.y && depth == other.depth && radius == other.radius && direction == other.direction;
+			}
+		};
+
+		unsigned int m_FramebufferID;
+		// sampled cascades, and the cached static casters they are composed from
+		unsigned int m_DepthID;
+		unsigned int m_StaticID;
+		unsigned int m_Resolution;
+		float m_ShadowDistance;
+		// how far in front of a cascade casters are still rendered, along the light direction
+		float m_CasterDistance;
+		// cascades below this index are updated every frame
+		unsigned int m_EveryFrameCascades;
+		// texels per snap step across the light
+		unsigned int m_SnapTexels;
+		unsigned long long m_Frame;
+		// the view of the last update, and whether this one differs from it
+		glm::mat4 m_LastView;
+		bool m_CameraMoving;
+
+		Shader* m_DepthShader;
+		shaders::ShadowDepthInterface m_DepthInterface;
+
+		ShadowBlock m_Block;
+		bool m_Rendered[SHADOW_CASCADES];
+		bool m_Pending[SHADOW_CASCADES];
+		glm::mat4 m_PendingViewProjection[SHADOW_CASCADES];
+		float m_PendingTexelSize[SHADOW_CASCADES];
+		CascadeOrigin m_PendingOrigin[SHADOW_CASCADES];
+
+		// static layer cache, a layer is stale while the sampled one holds anything else
+		bool m_StaticValid[SHADOW_CASCADES];
+		glm::mat4 m_StaticViewProjection[SHADOW_CASCADES];
+		CascadeOrigin m_StaticOrigin[SHADOW_CASCADES];
+		bool m_Stale[SHADOW_CASCADES];
+		bool m_Committed[SHADOW_CASCADES];
+		bool m_DynamicDrawn[SHADOW_CASCADES];
+		ShadowCacheStats m_Stats[SHADOW_CASCADES];
+		// the same, counted only in frames where the camera moved
+		ShadowCacheStats m_MovingStats[SHADOW_CASCADES];
+
+	public:
+		// format is the vertex format of the pool the casters come from
+		CascadedShadowMap(unsigned int resolution = 2048, float shadowDistance = 50.0f, bool async = false, VertexFormat format = FULL_VERTICES);
+		~CascadedShadowMap();
+
+		// fits the cascades to the camera frustum, fovY in radians. Decides which cascades
+		// are rendered this frame
+		void update(const glm::mat4 &view, float fovY, float aspect, float nearPlane, float farPlane, const glm::vec3 &lightDirection);
+
+		// binds the cascade's static or sampled layer and the depth program. False when the
+		// cascade isn't due this frame, and for the static pass when the cached layer still holds
+		bool beginCascade(unsigned int cascade, ShadowCasters casters);
+		// composes the cascades without a dynamic pass, restores the default framebuffer
+		void endCascades(unsigned int width, unsigned int height);
+
+		// a static caster inside this world space sphere moved, appeared or went away
+		void invalidate(const glm::vec3 &center, float radius);
+		void invalidateAll();
+
+		// binds the texture array at SHADOW_CASCADE_UNIT and the Shadows block through constants
+		void bindForReading(RingBuffer* constants) const;
+
+		inline void setCasterDistance(float distance) { m_CasterDistance = distance; }
+		inline void setEveryFrameCascades(unsigned int count) { m_EveryFrameCascades = count; }
+		// less than the resolution, takes effect as the cascades are fitted again
+		inline void setSnapTexels(unsigned int texels) { m_SnapTexels = std::max(1u, std::min(texels, m_Resolution / 2)); }
+		inline unsigned int getResolution() const { return m_Resolution; }
+		inline float getShadowDistance() const { return m_ShadowDistance; }
+		inline const ShadowCacheStats &getStats(unsigned int cascade) const { return m_Stats[cascade]; }
+		inline const ShadowCacheStats &getMovingStats(unsigned int cascade) const { return m_MovingStats[cascade]; }
+
+		void printStats() const;
+
+	private:
+		void bindLayer(unsigned int texture, unsigned int cascade, const glm::mat4 &viewProjection);
+		void copyStatic(unsigned int cascade);
+		glm::mat4 fitCascade(const glm::mat4 &invView, float fovY, float aspect, float sliceNear, float sliceFar, const glm::vec3 &lightDirection, float &texelSize, CascadeOrigin &origin) const;
+	};
+}
@@ -0,0 +1,253 @@
+#include "pointshadowmap.h"
+#include "../glstate.h"
+
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace graphics {
+
+	PointShadowMap::PointShadowMap(unsigned int maxLights, unsigned int resolution, bool async, VertexFormat format)
+		:m_Resolution(resolution), m_MaxLights(maxLights), m_Ready(false), m_Layer(maxLights),
+		m_TargetBound(false), m_LightRadius(0.0f)
+	{
+		// six layer-faces per light, linear filtering with depth compare for a 2x2 PCF per lookup.
+		// The static array is only copied from, same storage so whole cubes can be copied
+		unsigned int* textures[2] = { &m_DepthID, &m_StaticID };
+		for (int i = 0; i < 2; i++)
+		{
+			glGenTextures(1, textures[i]);
+			GLState::bindTexture(0, GL_TEXTURE_CUBE_MAP_ARRAY, *textures[i]);
+			glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT32F, m_Resolution, m_Resolution, m_MaxLights * 6);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		}
+
+		// a cube view per light is attached layered, the geometry shader picks the face with
+		// gl_Layer and a clear only touches that light. Everything starts out unshadowed
+		m_DepthViews.resize(m_MaxLights);
+		m_StaticViews.resize(m_MaxLights);
+		m_DepthFramebuffers.resize(m_MaxLights);
+		m_StaticFramebuffers.resize(m_MaxLights);
+		GLState::setDepthMask(true);
+		for (unsigned int light = 0; light < m_MaxLights; light++)
+		{
+			unsigned int* views[2] = { &m_DepthViews[light], &m_StaticViews[light] };
+			unsigned int* framebuffers[2] = { &m_DepthFramebuffers[light], &m_StaticFramebuffers[light] };
+			for (int i = 0; i < 2; i++)
+			{
+				glGenTextures(1, views[i]);
+				glTextureView(*views[i], GL_TEXTURE_CUBE_MAP, *textures[i], GL_DEPTH_COMPONENT32F, 0, 1, light * 6, 6);
+				glGenFramebuffers(1, framebuffers[i]);
+				glBindFramebuffer(GL_FRAMEBUFFER, *framebuffers[i]);
+				glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, *views[i], 0);
+				glDrawBuffer(GL_NONE);
+				glReadBuffer(GL_NONE);
+				if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+					std::cout << "ERROR::POINTSHADOWMAP::FRAMEBUFFER_INCOMPLETE" << std::endl;
+				glClear(GL_DEPTH_BUFFER_BIT);
+			}
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		LightCache cache;
+		cache.valid = false;
+		cache.position = glm::vec3(0.0f);
+		cache.radius = 0.0f;
+		cache.stale = false;
+		cache.touched = false;
+		cache.dynamicDrawn = false;
+		m_Cache.resize(m_MaxLights, cache);
+
+		ShaderDefines defines;
+		defines.set("COMPACT_VERTICES", format == COMPACT_VERTICES ? 1 : 0);
+		m_DepthShader = new Shader("resources/shaders/point_shadow.vs", "resources/shaders/point_shadow.fs", "resources/shaders/point_shadow.gs", defines, async);
+	}
+
+	PointShadowMap::~PointShadowMap()
+	{
+		delete m_DepthShader;
+		for (unsigned int light = 0; light < m_MaxLights; light++)
+		{
+			glDeleteFramebuffers(1, &m_DepthFramebuffers[light]);
+			glDeleteFramebuffers(1, &m_StaticFramebuffers[light]);
+			GLState::deleteTexture(m_DepthViews[light]);
+			GLState::deleteTexture(m_StaticViews[light]);
+		}
+		GLState::deleteTexture(m_DepthID);
+		GLState::deleteTexture(m_StaticID);
+	}
+
+	bool PointShadowMap::begin()
+	{
+		m_Ready = m_DepthShader->isReady();
+		m_Layer = m_MaxLights;
+		if (!m_Ready)
+			return false;
+
+		m_DepthShader->enable();
+		m_Interface.resolve(m_DepthShader);
+		return true;
+	}
+
+	bool PointShadowMap::beginLight(unsigned int layer, const glm::vec3 &position, float radius, ShadowCasters casters)
+	{
+		m_Layer = m_MaxLights;
+		if (!m_Ready || layer >= m_MaxLights || radius <= 0.0f)
+			return false;
+		LightCache &cache = m_Cache[layer];
+		cache.touched = true;
+
+		if (casters == STATIC_CASTERS)
+		{
+			if (cache.valid && cache.position == position && cache.radius == radius)
+			{
+				cache.stats.hits++;
+				return false;
+			}
+			cache.stats.misses++;
+			cache.valid = true;
+			cache.position = position;
+			cache.radius = radius;
+			cache.stale = true;
+			bindTarget(m_StaticFramebuffers[layer]);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			m_TargetBound = true;
+		}
+		else
+			m_TargetBound = false;
+		m_Layer = layer;
+		m_LightPosition = position;
+		m_LightRadius = radius;
+
+		// GL cube map face orientations, +x -x +y -y +z -z
+		static const glm::vec3 directions[6] = {
+			glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+		};
+		static const glm::vec3 ups[6] = {
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+		};
+		glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, radius);
+		for (int face = 0; face < 6; face++)
+			m_DepthShader->set(m_Interface.faceViewProjection[face], projection * glm::lookAt(position, position + directions[face], ups[face]));
+		m_DepthShader->set(m_Interface.lightPositionRadius, glm::vec4(position, radius));
+		return true;
+	}
+
+	bool PointShadowMap::beginCaster(const glm::vec3 &center, float radius)
+	{
+		if (!m_Ready || m_Layer >= m_MaxLights)
+			return false;
+		glm::vec3 offset = center - m_LightPosition;
+		if (glm::length(offset) > m_LightRadius + radius)
+			return false;
+		unsigned int mask = faceMask(offset, radius);
+		if (mask == 0)
+			return false;
+
+		// first dynamic caster of the light, start from the static cube
+		if (!m_TargetBound)
+		{
+			LightCache &cache = m_Cache[m_Layer];
+			if (cache.stale)
+				copyStatic(m_Layer);
+			cache.stale = true;
+			cache.dynamicDrawn = true;
+			bindTarget(m_DepthFramebuffers[m_Layer]);
+			m_TargetBound = true;
+		}
+		m_DepthShader->set(m_Interface.faceMask, (int)mask);
+		return true;
+	}
+
+	void PointShadowMap::end(unsigned int width, unsigned int height)
+	{
+		for (unsigned int light = 0; light < m_MaxLights; light++)
+		{
+			// without dynamic casters the sampled cube is the static one, copied only when it changed
+			LightCache &cache = m_Cache[light];
+			if (cache.touched && !cache.dynamicDrawn && cache.stale)
+			{
+				copyStatic(light);
+				cache.stale = false;
+			}
+			cache.touched = false;
+			cache.dynamicDrawn = false;
+		}
+		m_Ready = false;
+		m_Layer = m_MaxLights;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width, height);
+	}
+
+	void PointShadowMap::invalidate(const glm::vec3 &center, float radius)
+	{
+		for (unsigned int light = 0; light < m_MaxLights; light++)
+			if (m_Cache[light].valid && glm::length(center - m_Cache[light].position) <= m_Cache[light].radius + radius)
+				m_Cache[light].valid = false;
+	}
+
+	void PointShadowMap::invalidateAll()
+	{
+		for (unsigned int light = 0; light < m_MaxLights; light++)
+			m_Cache[light].valid = false;
+	}
+
+	void PointShadowMap::bindForReading() const
+	{
+		GLState::bindTexture(POINT_SHADOW_UNIT, GL_TEXTURE_CUBE_MAP_ARRAY, m_DepthID);
+	}
+
+	void PointShadowMap::printStats() const
+	{
+		std::cout << "Point shadow static cache hits:";
+		for (unsigned int light = 0; light < m_MaxLights; light++)
+			std::cout << " " << light << ": " << m_Cache[light].stats.hitRate() << "%";
+		std::cout << std::endl;
+	}
+
+	unsigned int PointShadowMap::faceMask(const glm::vec3 &offset, float radius)
+	{
+		// the +x face sees x >= |y| and x >= |z|. Its four side planes have normals like
+		// (1, -1, 0) / sqrt(2), so the sphere touches the face when s * x + r * sqrt(2)
+		// reaches past |y| and |z|, likewise for the other axes
+		float reach = radius * 1.41421356f;
+		unsigned int mask = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float b = std::abs(offset[(axis + 1) % 3]);
+			float c = std::abs(offset[(axis + 2) % 3]);
+			for (int side = 0; side < 2; side++)
+			{
+				float along = (side == 0 ? offset[axis] : -offset[axis]) + reach;
+				if (along >= b && along >= c)
+					mask |= 1u << (axis * 2 + side);
+			}
+		}
+		return mask;
+	}
+
+	void PointShadowMap::bindTarget(unsigned int framebuffer)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, m_Resolution, m_Resolution);
+		GLState::setDepthMask(true);
+		GLState::setDepthTest(true);
+		GLState::setDepthFunc(GL_LESS);
+		GLState::setBlend(false);
+	}
+
+	void PointShadowMap::copyStatic(unsigned int layer)
+	{
+		glCopyImageSubData(m_StaticID, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, layer * 6,
+			m_DepthID, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, layer * 6, m_Resolution, m_Resolution, 6);
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <vector>
+
+#include "../shader.h"
+#include "../shaderinterfaces.h"
+#include "../buffers/geometrypool.h"
+#include "shadowcache.h"
+
+namespace graphics {
+
+	// texture unit model.fs and deferred_light.fs sample the point light shadows from
+	enum PointShadowUnit {
+		POINT_SHADOW_UNIT = 9
+	};
+
+	// Cube shadow maps of a few point lights, one cube array layer per light. Every light is
+	// rendered in a single pass: point_shadow.gs runs one invocation per cube face and routes
+	// each triangle to its face with gl_Layer, so the casters are submitted once instead of six
+	// times. Before a caster is drawn its bounding sphere is tested against the light radius and
+	// the six face frusta, faces it can't touch are skipped in the geometry shader.
+	//
+	// The cubes store the distance to the light divided by its radius, the lit passes compare
+	// against the same. A light uses its layer when PointLightData::shadowIndex is set to it.
+	//
+	// Static casters are kept in a second cube array that is only redrawn when the light moves
+	// or invalidate() reaches it. Dynamic casters are drawn on top of a copy; the copy is skipped
+	// while the sampled cube still matches the static one. Each light's cube is reached through
+	// texture views of its six layer-faces, so lights are cleared and drawn independently.
+	//
+	// per frame:
+	//   begin()
+	//   for every shadowed light:
+	//     if (beginLight(layer, position, radius, STATIC_CASTERS)) {
+	//         for every static caster: if (beginCaster(center, radius)) draw it with Model::DrawDepth }
+	//     if (beginLight(layer, position, radius, DYNAMIC_CASTERS)) {
+	//         for every dynamic caster: if (beginCaster(center, radius)) draw it }
+	//   end(...)
+	//   bindForReading() before the lit passes
+	class PointShadowMap
+	{
+	private:
+		// per light state of the static layer cache
+		struct LightCache {
+			bool valid;
+			glm::vec3 position;
+			float radius;
+			// the sampled cube holds anything but the static one
+			bool stale;
+			// passes this frame
+			bool touched;
+			bool dynamicDrawn;
+			ShadowCacheStats stats;
+		};
+
+		unsigned int m_DepthID, m_StaticID;
+		// cube map views of each light's layer-faces and their framebuffers, sampled and static
+		std::vector<unsigned int> m_DepthViews, m_StaticViews;
+		std::vector<unsigned int> m_DepthFramebuffers, m_StaticFramebuffers;
+		unsigned int m_Resolution;
+		unsigned int m_MaxLights;
+
+		Shader* m_DepthShader;
+		shaders::PointShadowInterface m_Interface;
+		std::vector<LightCache> m_Cache;
+
+		// light of the pass in progress, the dynamic pass binds its target with the first caster
+		bool m_Ready;
+		unsigned int m_Layer;
+		bool m_TargetBound;
+		glm::vec3 m_LightPosition;
+		float m_LightRadius;
+
+	public:
+		// format is the vertex format of the pool the casters come from
+		PointShadowMap(unsigned int maxLights = 4, unsigned int resolution = 512, bool async = false, VertexFormat format = FULL_VERTICES);
+		~PointShadowMap();
+
+		// binds the depth program, false while it compiles
+		bool begin();
+		// sets up the six faces of layer's cube around the light. False for the static pass when
+		// the cached cube still holds
+		bool beginLight(unsigned int layer, const glm::vec3 &position, float radius, ShadowCasters casters);
+		// face mask of a caster's world space bounding sphere, false when it misses the light
+		bool beginCaster(const glm::vec3 &center, float radius);
+		// composes the lights without dynamic casters, restores the default framebuffer
+		void end(unsigned int width, unsigned int height);
+
+		// a static caster inside this world space sphere moved, appeared or went away
+		void invalidate(const glm::vec3 &center, float radius);
+		void invalidateAll();
+
+		// binds the cube array at POINT_SHADOW_UNIT
+		void bindForReading() const;
+
+		// bit per cube face (+x, -x, +y, -y, +z, -z) whose frustum the sphere intersects, offset
+		// is the sphere's center relative to the light
+		static unsigned int faceMask(const glm::vec3 &offset, float radius);
+
+		inline unsigned int getMaxLights() const { return m_MaxLights; }
+		inline unsigned int getResolution() const { return m_Resolution; }
+		inline const ShadowCacheStats &getStats(unsigned int layer) const { return m_Cache[layer].stats; }
+
+		void printStats() const;
+
+	private:
+		void bindTarget(unsigned int framebuffer);
+		void copyStatic(unsigned int layer);
+	};
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+namespace graphics {
+
+	// Which casters a shadow pass draws. Static casters go into a cached layer that is only
+	// redrawn when its light moves or the layer is invalidated, dynamic casters are drawn every
+	// update on top of a copy of it. Per light, the static pass has to come first.
+	enum ShadowCasters {
+		STATIC_CASTERS = 0,
+		DYNAMIC_CASTERS = 1
+	};
+
+	// static layer reuse of one light or cascade
+	struct ShadowCacheStats {
+		unsigned long long hits;
+		unsigned long long misses;
+
+		ShadowCacheStats() : hits(0), misses(0) {}
+
+		inline float hitRate() const { return hits + misses > 0 ? 100.0f * hits / (hits + misses) : 0.0f; }
+	};
+}
@@ -1,12 +1,14 @@
 #include "texture.h"
+#include "glstate.h"
 #include <stb/stb_image.h>
 namespace graphics {
 
 	Texture::Texture(const char * textureSource)
+		:m_Unit(0)
 	{
 		
 		glGenTextures(1, &m_TextureID);
-		glBindTexture(GL_TEXTURE_2D, m_TextureID);
+		GLState::bindTexture(0, GL_TEXTURE_2D, m_TextureID);
 		// set the texture wrapping parameters
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -43,21 +45,23 @@ namespace graphics {
 	}
 	Texture::~Texture()
 	{
-		glDeleteTextures(1, &m_TextureID);
+		GLState::deleteTexture(m_TextureID);
 	}
 
 	// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 	// -------------------------------------------------------------------------------
 	void Texture::bind(int glTextureN) const
 	{
-		glActiveTexture(GL_TEXTURE0 + glTextureN);
-		glBindTexture(GL_TEXTURE_2D, m_TextureID);
+		m_Unit = glTextureN;
+		GLState::bindTexture(glTextureN, GL_TEXTURE_2D, m_TextureID);
 	}
 
 	// Check if Shader should be closed
 	// --------------------------------
 	void Texture::unbind() const
 	{
-		glBindTexture(GL_TEXTURE_2D, 0);
+#if GLSTATE_UNBIND
+		GLState::bindTexture(m_Unit, GL_TEXTURE_2D, 0);
+#endif
 	}
 }
\ No newline at end of file
@@ -10,6 +10,8 @@ namespace graphics {
 	private:
 		unsigned int m_TextureID;
 		int m_Width, m_Height, m_NrChannels;
+		// unit of the last bind, unbind clears that one
+		mutable int m_Unit;
 
 	public:
 		Texture(const char * textureSource);
@@ -0,0 +1,198 @@
+#include "texturepool.h"
+#include "glstate.h"
+#include <stb/stb_image.h>
+
+#include <algorithm>
+
+namespace graphics {
+
+	TexturePool::TexturePool()
+		:m_MaterialCapacity(64), m_MaterialsDirty(false)
+	{
+		// sized up front so the Materials block is valid before the first material arrives
+		glGenBuffers(1, &m_MaterialBuffer);
+		GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_MaterialBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, m_MaterialCapacity * sizeof(MaterialData), NULL, GL_STATIC_DRAW);
+	}
+
+	TexturePool::~TexturePool()
+	{
+		for (unsigned int i = 0; i < m_Slabs.size(); i++)
+			GLState::deleteTexture(m_Slabs[i].texture);
+		GLState::deleteBuffer(m_MaterialBuffer);
+	}
+
+	void TexturePool::expect(const std::string &path, bool gamma)
+	{
+		if (m_Loaded.find(path) != m_Loaded.end() || m_Expected.find(path) != m_Expected.end())
+			return;
+		m_Expected.insert(path);
+
+		SlabFormat slabFormat;
+		GLenum format;
+		int components;
+		if (stbi_info(path.c_str(), &slabFormat.width, &slabFormat.height, &components) &&
+			getFormats(components, gamma, format, slabFormat.internalFormat))
+			m_Pending[slabFormat]++;
+	}
+
+	TextureLocation TexturePool::load(const std::string &path, bool gamma)
+	{
+		std::map<std::string, TextureLocation>::iterator it = m_Loaded.find(path);
+		if (it != m_Loaded.end())
+			return it->second;
+
+		TextureLocation location;
+		int width, height, nrComponents;
+		unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
+		if (data)
+			location = add(data, width, height, nrComponents, gamma);
+		else
+			std::cout << "Texture failed to load at path: " << path << std::endl;
+		stbi_image_free(data);
+
+		m_Loaded[path] = location;
+		return location;
+	}
+
+	TextureLocation TexturePool::add(const unsigned char* pixels, int width, int height, int components, bool gamma)
+	{
+		TextureLocation location;
+		SlabFormat slabFormat;
+		GLenum format;
+		if (!getFormats(components, gamma, format, slabFormat.internalFormat))
+		{
+			std::cout << "ERROR::TEXTUREPOOL::UNSUPPORTED_COMPONENTS " << components << std::endl;
+			return location;
+		}
+		slabFormat.width = width;
+		slabFormat.height = height;
+
+		location.slab = findSlab(slabFormat);
+		Slab &slab = m_Slabs[location.slab];
+		location.layer = (int)slab.layers++;
+		slab.dirty = true;
+		std::map<SlabFormat, unsigned int>::iterator pending = m_Pending.find(slabFormat);
+		if (pending != m_Pending.end() && pending->second > 0)
+			pending->second--;
+
+		// rows of 1 and 3 component images aren't 4 byte aligned
+		GLState::bindTexture(0, GL_TEXTURE_2D_ARRAY, slab.texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, location.layer, width, height, 1, format, GL_UNSIGNED_BYTE, pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		return location;
+	}
+
+	unsigned int TexturePool::addMaterial(const MaterialData &material)
+	{
+		for (unsigned int i = 0; i < m_Materials.size(); i++)
+		{
+			const MaterialData &known = m_Materials[i];
+			if (known.diffuseLayer == material.diffuseLayer && known.specularLayer == material.specularLayer &&
+				known.normalLayer == material.normalLayer && known.shininess == material.shininess)
+				return i;
+		}
+		m_Materials.push_back(material);
+		m_MaterialsDirty = true;
+		return (unsigned int)m_Materials.size() - 1;
+	}
+
+	void TexturePool::bindMaterials()
+	{
+		for (unsigned int i = 0; i < m_Slabs.size(); i++)
+		{
+			if (!m_Slabs[i].dirty)
+				continue;
+			GLState::bindTexture(0, GL_TEXTURE_2D_ARRAY, m_Slabs[i].texture);
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+			m_Slabs[i].dirty = false;
+		}
+
+		if (m_MaterialsDirty)
+		{
+			unsigned int count = (unsigned int)m_Materials.size();
+			GLState::bindBuffer(GL_COPY_WRITE_BUFFER, m_MaterialBuffer);
+			if (count > m_MaterialCapacity)
+			{
+				while (m_MaterialCapacity < count)
+					m_MaterialCapacity *= 2;
+				glBufferData(GL_COPY_WRITE_BUFFER, m_MaterialCapacity * sizeof(MaterialData), NULL, GL_STATIC_DRAW);
+			}
+			glBufferSubData(GL_COPY_WRITE_BUFFER, 0, count * sizeof(MaterialData), &m_Materials[0]);
+			m_MaterialsDirty = false;
+		}
+		GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_STORAGE_BINDING, m_MaterialBuffer);
+	}
+
+	void TexturePool::printStats() const
+	{
+		unsigned int layers = 0, capacity = 0;
+		for (unsigned int i = 0; i < m_Slabs.size(); i++)
+		{
+			layers += m_Slabs[i].layers;
+			capacity += m_Slabs[i].capacity;
+		}
+		std::cout << "Texture pool: " << layers << " textures in " << m_Slabs.size() << " array slabs of "
+			<< capacity << " layers, " << m_Materials.size() << " materials" << std::endl;
+	}
+
+	int TexturePool::findSlab(const SlabFormat &format)
+	{
+		for (unsigned int i = 0; i < m_Slabs.size(); i++)
+		{
+			const Slab &slab = m_Slabs[i];
+			if (slab.format.internalFormat == format.internalFormat && slab.format.width == format.width &&
+				slab.format.height == format.height && slab.layers < slab.capacity)
+				return (int)i;
+		}
+
+		// room for the announced textures still to come, the storage is immutable
+		std::map<SlabFormat, unsigned int>::const_iterator pending = m_Pending.find(format);
+		Slab slab;
+		slab.format = format;
+		slab.layers = 0;
+		slab.capacity = pending != m_Pending.end() ? std::min(std::max(pending->second, 1u), SLAB_LAYERS) : 1;
+		slab.dirty = false;
+		int levels = 1;
+		while ((std::max(format.width, format.height) >> levels) > 0)
+			levels++;
+
+		glGenTextures(1, &slab.texture);
+		GLState::bindTexture(0, GL_TEXTURE_2D_ARRAY, slab.texture);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format.internalFormat, format.width, format.height, slab.capacity);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		m_Slabs.push_back(slab);
+		return (int)m_Slabs.size() - 1;
+	}
+
+	bool TexturePool::getFormats(int components, bool gamma, GLenum &format, GLenum &internalFormat)
+	{
+		if (components == 1)
+		{
+			format = GL_RED;
+			internalFormat = GL_R8;
+		}
+		else if (components == 2)
+		{
+			format = GL_RG;
+			internalFormat = GL_RG8;
+		}
+		else if (components == 3)
+		{
+			format = GL_RGB;
+			internalFormat = gamma ? GL_SRGB8 : GL_RGB8;
+		}
+		else if (components == 4)
+		{
+			format = GL_RGBA;
+			internalFormat = gamma ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		}
+		else
+			return false;
+		return true;
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "uniformblocks.h"
+
+namespace graphics {
+
+	// texture units of the material maps, the layout (binding = N) of the samplers in model.fs
+	enum MaterialUnit {
+		DIFFUSE_MAP_UNIT = 0,
+		SPECULAR_MAP_UNIT = 1,
+		NORMAL_MAP_UNIT = 2,
+		MATERIAL_MAP_COUNT = 3
+	};
+
+	// where a texture ended up, slab -1 if it couldn't be loaded
+	struct TextureLocation {
+		int slab;
+		int layer;
+
+		TextureLocation() : slab(-1), layer(-1) {}
+	};
+
+	// Material textures packed into layers of 2D array textures. Textures of the same size and
+	// format share an array (a slab) of up to SLAB_LAYERS layers, a full slab starts the next one.
+	// A slab only gets as many layers as textures of its size and format were announced with
+	// expect() and not loaded yet, at least one, so a lone texture doesn't pay for a whole slab.
+	// Loaders announce everything they are about to load first, see Model::loadModel.
+	// Meshes only differ in the layers they sample as long as their maps come from the same slabs,
+	// so the RenderQueue batches them without rebinding anything; the layers and constants of
+	// each material live in the Materials storage buffer and are picked per draw.
+	//
+	// mipmaps of a slab are regenerated for the whole array by bindMaterials after layers were added.
+	class TexturePool
+	{
+	public:
+		static const unsigned int SLAB_LAYERS = 16;
+
+	private:
+		struct SlabFormat {
+			GLenum internalFormat;
+			int width, height;
+
+			inline bool operator<(const SlabFormat &other) const
+			{
+				if (internalFormat != other.internalFormat)
+					return internalFormat < other.internalFormat;
+				if (width != other.width)
+					return width < other.width;
+				return height < other.height;
+			}
+		};
+
+		struct Slab {
+			unsigned int texture;
+			SlabFormat format;
+			unsigned int layers;
+			unsigned int capacity;
+			bool dirty;
+		};
+
+		std::vector<Slab> m_Slabs;
+		// loaded files by path, loading one twice returns the same layer
+		std::map<std::string, TextureLocation> m_Loaded;
+		// announced files, and how many of each format are still to come
+		std::set<std::string> m_Expected;
+		std::map<SlabFormat, unsigned int> m_Pending;
+
+		std::vector<MaterialData> m_Materials;
+		unsigned int m_MaterialBuffer;
+		unsigned int m_MaterialCapacity;
+		bool m_MaterialsDirty;
+
+	public:
+		TexturePool();
+		~TexturePool();
+
+		// announces a file load() will be called for, only its header is read. Slabs created
+		// afterwards are sized for the announced textures of their format
+		void expect(const std::string &path, bool gamma = false);
+		// loads an image file into a slab, gamma stores color maps as sRGB
+		TextureLocation load(const std::string &path, bool gamma = false);
+		// 8 bit pixels with 1, 2, 3 or 4 components per texel
+		TextureLocation add(const unsigned char* pixels, int width, int height, int components, bool gamma = false);
+
+		// index of the material in the Materials block, equal materials share one
+		unsigned int addMaterial(const MaterialData &material);
+
+		// uploads what changed since the last call and binds the Materials block, once per frame
+		// before anything samples the maps
+		void bindMaterials();
+
+		// array texture of a slab, 0 for slab -1
+		inline unsigned int getSlabTexture(int slab) const { return slab >= 0 ? m_Slabs[slab].texture : 0; }
+		inline unsigned int getSlabCount() const { return (unsigned int)m_Slabs.size(); }
+		inline unsigned int getMaterialCount() const { return (unsigned int)m_Materials.size(); }
+
+		void printStats() const;
+
+	private:
+		// slab with a free layer for the size and format, created if there is none
+		int findSlab(const SlabFormat &format);
+
+		// upload and storage format of 8 bit pixels, false for unsupported component counts
+		static bool getFormats(int components, bool gamma, GLenum &format, GLenum &internalFormat);
+	};
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace graphics {
+
+	// fixed binding points shared by every program, see layout(std140, binding = N) in the shaders
+	enum UniformBlockBinding {
+		CAMERA_BLOCK_BINDING = 0,
+		LIGHTS_BLOCK_BINDING = 1,
+		CLUSTER_BLOCK_BINDING = 3,
+		DEFERRED_BLOCK_BINDING = 4,
+		SHADOW_BLOCK_BINDING = 5
+	};
+
+	// fixed shader storage binding points, see layout(std430, binding = N) buffer in the shaders
+	enum StorageBlockBinding {
+		POINT_LIGHT_STORAGE_BINDING = 0,
+		CLUSTER_RANGE_STORAGE_BINDING = 1,
+		CLUSTER_INDEX_STORAGE_BINDING = 2,
+		INSTANCE_STORAGE_BINDING = 3,
+		DRAW_STORAGE_BINDING = 4,
+		MATERIAL_STORAGE_BINDING = 5,
+		MESH_STORAGE_BINDING = 6
+	};
+
+	// C++ mirrors of the std140 uniform blocks. vec3 members are followed by a float so every
+	// vec3 + float pair fills one 16 byte std140 slot, keep the member order in sync with the shaders.
+
+	struct CameraBlock {
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 viewPos;
+		float padding;
+	};
+
+	// per-instance transforms, one element of the Instances storage buffer per instance.
+	// Streamed through a RingBuffer, a draw finds its own through its DrawRecord. std430 pads every mat3
+	// column to a vec4, fill it with DrawTransforms
+	struct DrawBlock {
+		glm::mat4 model;
+		glm::mat3x4 normalMatrix;	// transpose(inverse(mat3(model)))
+	};
+
+	// one per draw of the Draws storage buffer, indexed by aDrawID (see GeometryPool). The draw's
+	// instances start at firstInstance in the Instances block, mesh indexes the Meshes block
+	struct DrawRecord {
+		unsigned int firstInstance;
+		unsigned int material;
+		unsigned int mesh;
+		unsigned int padding;
+	};
+
+	// one per mesh of the Meshes storage buffer, filled by the GeometryPool. Model space position
+	// = aPos * scale + bias, which undoes the 16 bit quantization of compact vertices and is the
+	// identity for full ones
+	struct MeshBounds {
+		glm::vec4 scale;
+		glm::vec4 bias;
+	};
+
+	// one per material of the Materials storage buffer, filled by the TexturePool. Layers of the
+	// slabs bound at the map units, -1 where the mesh has no such map
+	struct MaterialData {
+		int diffuseLayer;
+		int specularLayer;
+		int normalLayer;
+		float shininess;
+	};
+
+	struct DirLightData {
+		glm::vec3 direction;
+		float padding0;
+		glm::vec3 ambient;
+		float padding1;
+		glm::vec3 diffuse;
+		float padding2;
+		glm::vec3 specular;
+		float padding3;
+	};
+
+	struct PointLightData {
+		glm::vec3 position;
+		float constant;
+		glm::vec3 ambient;
+		float linear;
+		glm::vec3 diffuse;
+		float quadratic;
+		glm::vec3 specular;
+		float radius;	// where the light is cut off, see LightManager::computeRadius
+		int shadowIndex;	// cube of the PointShadowMap, -1 when unshadowed
+		int padding[3];
+	};
+
+	struct SpotLightData {
+		glm::vec3 position;
+		float constant;
+		glm::vec3 direction;
+		float linear;
+		glm::vec3 ambient;
+		float quadratic;
+		glm::vec3 diffuse;
+		float cutOff;
+		glm::vec3 specular;
+		float outerCutOff;
+	};
+
+	// point lights live in the shader storage buffer at POINT_LIGHT_STORAGE_BINDING, filled by
+	// the LightManager, the block only carries how many of them there are
+	struct LightsBlock {
+		DirLightData dirLight;
+		SpotLightData spotLight;
+		unsigned int pointLightCount;
+		unsigned int padding[3];
+	};
+
+	// cluster grid of the USE_CLUSTERED_LIGHTS permutation, filled by ClusterGrid
+	struct ClusterBlock {
+		glm::uvec4 clusterGrid;		// clusters along x, y and z, w = number of lights
+		glm::vec4 clusterParams;	// tile size in pixels (x, y), depth slice scale and bias
+	};
+
+	// lighting passes of the DeferredRenderer
+	struct DeferredBlock {
+		glm::mat4 invViewProjection;	// NDC back to world space
+		glm::vec4 screenSize;			// width, height, 1 / width, 1 / height
+	};
+
+	// directional light cascades of CascadedShadowMap, SHADOW_CASCADES matches the shaders' define
+	static const unsigned int SHADOW_CASCADES = 4;
+
+	struct ShadowBlock {
+		glm::mat4 cascadeViewProjection[SHADOW_CASCADES];
+		glm::vec4 cascadeSplits;		// view depth where each cascade ends
+		glm::vec4 cascadeTexelSize;		// world size of one shadow texel in each cascade
+		glm::vec4 shadowParams;			// normal offset in texels, depth bias, 1 / resolution
+	};
+
+	static_assert(sizeof(CameraBlock) == 144, "CameraBlock doesn't match the std140 layout");
+	static_assert(sizeof(DrawBlock) == 112, "DrawBlock doesn't match the std430 layout");
+	static_assert(sizeof(DrawRecord) == 16, "DrawRecord doesn't match the std430 layout");
+	static_assert(sizeof(MeshBounds) == 32, "MeshBounds doesn't match the std430 layout");
+	static_assert(sizeof(MaterialData) == 16, "MaterialData doesn't match the std430 layout");
+	static_assert(sizeof(DirLightData) == 64, "DirLightData doesn't match the std140 layout");
+	static_assert(sizeof(PointLightData) == 80, "PointLightData doesn't match the std430 layout");
+	static_assert(sizeof(SpotLightData) == 80, "SpotLightData doesn't match the std140 layout");
+	static_assert(sizeof(LightsBlock) == 160, "LightsBlock doesn't match the std140 layout");
+	static_assert(sizeof(ClusterBlock) == 32, "ClusterBlock doesn't match the std140 layout");
+	static_assert(sizeof(DeferredBlock) == 80, "DeferredBlock doesn't match the std140 layout");
+	static_assert(sizeof(ShadowBlock) == 304, "ShadowBlock doesn't match the std140 layout");
+}
@@ -1,4 +1,6 @@
 #include "window.h"
+#include "glextensions.h"
+#include "glstate.h"
 
 namespace graphics { 
 
@@ -64,9 +66,12 @@ namespace graphics {
 			std::cout << "Failed to initialize GLAD" << std::endl;
 			return false;
 		}
+		// resolve the extensions glad doesn't know about
+		GLExtensions::load();
+
 		// configure global opengl state
 		// -----------------------------
-		glEnable(GL_DEPTH_TEST);
+		GLState::setDepthTest(true);
 
 		return true;
 	}
@@ -0,0 +1,318 @@
+#!/usr/bin/env python3
+"""Generates src/graphics/shaderinterfaces.h from the GLSL sources in resources/shaders.
+
+For every program listed in PROGRAMS it emits a struct with one typed Uniform<T> member per
+default-block uniform (struct uniforms become nested structs, arrays become C++ arrays) and
+a resolve() that looks every handle up once per linked program. For every std140 uniform
+block it emits the binding point, the block size and each member's offset, and checks them
+against the hand-written C++ mirrors in uniformblocks.h with static_asserts.
+
+Uniforms are collected across all #if branches, so one interface serves every permutation;
+handles a permutation compiled out simply resolve to -1.
+
+Run from the project directory (the one holding RenderEngine.vcxproj) after editing a shader:
+    python tools/shaderinterface.py
+"""
+
+import os
+import re
+import sys
+
+SHADER_DIR = os.path.join('resources', 'shaders')
+OUTPUT = os.path.join('src', 'graphics', 'shaderinterfaces.h')
+
+# program name -> stages
+PROGRAMS = [
+    ('Model', ['model.vs', 'model.fs']),
+    ('Lamp', ['lamp.vs', 'lamp.fs']),
+    ('GBuffer', ['model.vs', 'gbuffer.fs']),
+    ('DeferredLight', ['deferred_light.vs', 'deferred_light.fs']),
+    ('ShadowDepth', ['shadow_depth.vs', 'shadow_depth.fs']),
+    ('PointShadow', ['point_shadow.vs', 'point_shadow.gs', 'point_shadow.fs']),
+]
+
+# GLSL block / struct name -> C++ mirror in uniformblocks.h
+CPP_MIRRORS = {
+    'Camera': ('CameraBlock', 'CAMERA_BLOCK_BINDING'),
+    'Lights': ('LightsBlock', 'LIGHTS_BLOCK_BINDING'),
+    'Clusters': ('ClusterBlock', 'CLUSTER_BLOCK_BINDING'),
+    'Deferred': ('DeferredBlock', 'DEFERRED_BLOCK_BINDING'),
+    'Shadows': ('ShadowBlock', 'SHADOW_BLOCK_BINDING'),
+    'DirLight': ('DirLightData', None),
+    'PointLight': ('PointLightData', None),
+    'SpotLight': ('SpotLightData', None),
+}
+
+CPP_TYPES = {
+    'bool': 'bool', 'int': 'int', 'uint': 'int', 'float': 'float',
+    'vec2': 'glm::vec2', 'vec3': 'glm::vec3', 'vec4': 'glm::vec4',
+    'ivec2': 'glm::ivec2', 'ivec3': 'glm::ivec3', 'ivec4': 'glm::ivec4',
+    'uvec2': 'glm::uvec2', 'uvec3': 'glm::uvec3', 'uvec4': 'glm::uvec4',
+    'mat2': 'glm::mat2', 'mat3': 'glm::mat3', 'mat4': 'glm::mat4',
+}
+
+# std140 base alignment and size of the basic types
+STD140 = {
+    'bool': (4, 4), 'int': (4, 4), 'uint': (4, 4), 'float': (4, 4),
+    'vec2': (8, 8), 'vec3': (16, 12), 'vec4': (16, 16),
+    'ivec2': (8, 8), 'ivec3': (16, 12), 'ivec4': (16, 16),
+    'uvec2': (8, 8), 'uvec3': (16, 12), 'uvec4': (16, 16),
+    'mat2': (16, 32), 'mat3': (16, 48), 'mat4': (16, 64),
+}
+
+
+def round_up(value, alignment):
+    return (value + alignment - 1) // alignment * alignment
+
+
+def strip_comments(source):
+    source = re.sub(r'/\*.*?\*/', '', source, flags=re.S)
+    return re.sub(r'//[^\n]*', '', source)
+
+
+def parse_members(body, defines):
+    members = []
+    for line in body.split('\n'):
+        line = line.strip()
+        if not line or line.startswith('#'):
+            continue
+        for declaration in line.split(';'):
+            declaration = declaration.strip()
+            if not declaration:
+                continue
+            match = re.match(r'(\w+)\s+(.+)$', declaration)
+            if not match:
+                sys.exit('cannot parse member "%s"' % declaration)
+            glsl_type = match.group(1)
+            for name in match.group(2).split(','):
+                name_match = re.match(r'\s*(\w+)\s*(?:\[\s*(\w+)\s*\])?\s*$', name)
+                count = name_match.group(2)
+                if count is not None:
+                    count = int(defines.get(count, count))
+                members.append((glsl_type, name_match.group(1), count))
+    return members
+
+
+class Program:
+    def __init__(self, name, stages):
+        self.name = name
+        self.structs = {}
+        self.blocks = {}
+        self.uniforms = []
+        defines = {}
+        for stage in stages:
+            with open(os.path.join(SHADER_DIR, stage)) as shader_file:
+                source = strip_comments(shader_file.read())
+            for define in re.finditer(r'^\s*#define\s+(\w+)\s+(\w+)\s*$', source, flags=re.M):
+                defines.setdefault(define.group(1), define.group(2))
+            for define in list(defines):
+                while defines[define] in defines:
+                    defines[define] = defines[defines[define]]
+            for struct in re.finditer(r'struct\s+(\w+)\s*\{(.*?)\}\s*;', source, flags=re.S):
+                self.merge_struct(struct.group(1), parse_members(struct.group(2), defines))
+            source = re.sub(r'struct\s+(\w+)\s*\{(.*?)\}\s*;', '', source, flags=re.S)
+            block_pattern = r'layout\s*\(([^)]*)\)\s*uniform\s+(\w+)\s*\{(.*?)\}\s*\w*\s*;'
+            for block in re.finditer(block_pattern, source, flags=re.S):
+                binding = re.search(r'binding\s*=\s*(\d+)', block.group(1))
+                self.blocks[block.group(2)] = (int(binding.group(1)) if binding else None,
+                                               parse_members(block.group(3), defines))
+            source = re.sub(block_pattern, '', source, flags=re.S)
+            for uniform in re.finditer(r'^\s*uniform\s+(\w+)\s+(\w+)\s*(?:\[\s*(\w+)\s*\])?\s*;', source, flags=re.M):
+                count = uniform.group(3)
+                if count is not None:
+                    count = int(defines.get(count, count))
+                entry = (uniform.group(1), uniform.group(2), count)
+                if entry not in self.uniforms:
+                    self.uniforms.append(entry)
+
+    # permutations may declare different members under #if, keep the union in source order
+    def merge_struct(self, name, members):
+        existing = self.structs.setdefault(name, [])
+        for member in members:
+            if member not in existing:
+                existing.append(member)
+
+    def layout(self, glsl_type):
+        """std140 (alignment, size, member offsets) of a basic type or struct."""
+        if glsl_type in STD140:
+            alignment, size = STD140[glsl_type]
+            return alignment, size, None
+        offsets = []
+        offset = 0
+        alignment = 16
+        for member_type, member_name, count in self.structs[glsl_type]:
+            member_alignment, member_size, _ = self.layout(member_type)
+            if count is not None:
+                member_alignment = round_up(member_alignment, 16)
+                stride = round_up(member_size, 16)
+                member_size = stride * count
+            offset = round_up(offset, member_alignment)
+            offsets.append((member_name, offset, count, stride if count is not None else None))
+            offset += member_size
+        return alignment, round_up(offset, 16), offsets
+
+
+def emit_uniform_struct(program, glsl_type, indent, out):
+    out.append('%sstruct %sUniforms {' % (indent, glsl_type))
+    for member_type, member_name, count in program.structs[glsl_type]:
+        emit_member(program, member_type, member_name, count, indent + '\t', out)
+    out.append('%s};' % indent)
+
+
+def emit_member(program, glsl_type, name, count, indent, out):
+    suffix = '[%d]' % count if count is not None else ''
+    if glsl_type in program.structs:
+        out.append('%s%sUniforms %s%s;' % (indent, glsl_type, name, suffix))
+    else:
+        out.append('%sUniform<%s> %s%s;' % (indent, CPP_TYPES.get(glsl_type, 'int'), name, suffix))
+
+
+def emit_resolve(program, glsl_type, cpp_path, glsl_path, count, out):
+    paths = [(cpp_path, glsl_path)] if count is None else \
+        [('%s[%d]' % (cpp_path, i), '%s[%d]' % (glsl_path, i)) for i in range(count)]
+    for cpp_name, glsl_name in paths:
+        if glsl_type in program.structs:
+            for member_type, member_name, member_count in program.structs[glsl_type]:
+                emit_resolve(program, member_type, cpp_name + '.' + member_name,
+                             glsl_name + '.' + member_name, member_count, out)
+        else:
+            out.append('\t\t\t%s.handle = shader->getUniformHandle("%s");' % (cpp_name, glsl_name))
+
+
+def emit_program(program, out):
+    structs = []
+    for glsl_type, _, _ in program.uniforms:
+        collect_structs(program, glsl_type, structs)
+
+    out.append('\t\t// %s program, default block uniforms' % program.name)
+    out.append('\t\tstruct %sInterface' % program.name)
+    out.append('\t\t{')
+    for glsl_type in structs:
+        emit_uniform_struct(program, glsl_type, '\t\t\t', out)
+        out.append('')
+    for glsl_type, name, count in program.uniforms:
+        emit_member(program, glsl_type, name, count, '\t\t\t', out)
+    out.append('')
+    out.append('\t\t\t// program the handles were resolved for')
+    out.append('\t\t\tconst Shader* program;')
+    out.append('')
+    out.append('\t\t\t%sInterface() : program(nullptr) {}' % program.name)
+    out.append('')
+    out.append('\t\t\t// looks every handle up once, a no-op while the program stays the same')
+    out.append('\t\t\tvoid resolve(const Shader* shader)')
+    out.append('\t\t\t{')
+    out.append('\t\t\t\tif (shader == program)')
+    out.append('\t\t\t\t\treturn;')
+    out.append('\t\t\t\tprogram = shader;')
+    resolve = []
+    for glsl_type, name, count in program.uniforms:
+        emit_resolve(program, glsl_type, name, name, count, resolve)
+    out.extend('\t' + line for line in resolve)
+    out.append('\t\t\t}')
+    out.append('\t\t};')
+    out.append('')
+
+
+def collect_structs(program, glsl_type, structs):
+    if glsl_type not in program.structs or glsl_type in structs:
+        return
+    for member_type, _, _ in program.structs[glsl_type]:
+        collect_structs(program, member_type, structs)
+    structs.append(glsl_type)
+
+
+def emit_layout(program, name, binding, members, out, asserts):
+    block_struct = '__block_' + name
+    program.structs[block_struct] = members
+    _, size, offsets = program.layout(block_struct)
+    del program.structs[block_struct]
+    emit_layout_struct(name, binding, size, offsets, out)
+    mirror = CPP_MIRRORS.get(name)
+    if mirror is not None:
+        emit_asserts(name, mirror, binding, size, offsets, asserts)
+    for member_type, _, _ in members:
+        if member_type in program.structs:
+            _, member_size, member_offsets = program.layout(member_type)
+            emit_layout_struct(member_type, None, member_size, member_offsets, out)
+            if member_type in CPP_MIRRORS:
+                emit_asserts(member_type, CPP_MIRRORS[member_type], None, member_size, member_offsets, asserts)
+
+
+def emit_layout_struct(name, binding, size, offsets, out):
+    if '\t\tstruct %sLayout' % name in out:
+        return
+    out.append('\t\tstruct %sLayout' % name)
+    out.append('\t\t{')
+    if binding is not None:
+        out.append('\t\t\tstatic const unsigned int binding = %d;' % binding)
+    out.append('\t\t\tstatic const unsigned int size = %d;' % size)
+    for member_name, offset, count, stride in offsets:
+        out.append('\t\t\tstatic const unsigned int %s = %d;' % (member_name, offset))
+        if count is not None:
+            out.append('\t\t\tstatic const unsigned int %sStride = %d;' % (member_name, stride))
+    out.append('\t\t};')
+    out.append('')
+
+
+def emit_asserts(name, mirror, binding, size, offsets, asserts):
+    cpp_struct, binding_enum = mirror
+    key = '// %s' % name
+    if key in asserts:
+        return
+    asserts.append(key)
+    asserts.append('\tstatic_assert(sizeof(%s) == shaders::%sLayout::size, "%s doesn\'t match GLSL %s");'
+                   % (cpp_struct, name, cpp_struct, name))
+    if binding_enum is not None:
+        asserts.append('\tstatic_assert(%s == shaders::%sLayout::binding, "%s doesn\'t match the GLSL %s binding");'
+                       % (binding_enum, name, binding_enum, name))
+    for member_name, offset, count, stride in offsets:
+        asserts.append('\tstatic_assert(offsetof(%s, %s) == shaders::%sLayout::%s, "%s::%s is misplaced");'
+                       % (cpp_struct, member_name, name, member_name, cpp_struct, member_name))
+
+
+def main():
+    programs = [Program(name, stages) for name, stages in PROGRAMS]
+    out = []
+    out.append('#pragma once')
+    out.append('')
+    out.append('// Generated by tools/shaderinterface.py from resources/shaders, do not edit.')
+    out.append('// Re-run the script after changing a uniform; code using a renamed or removed')
+    out.append('// uniform then fails to compile instead of silently setting nothing.')
+    out.append('')
+    out.append('#include <cstddef>')
+    out.append('')
+    out.append('#include "shader.h"')
+    out.append('#include "uniformblocks.h"')
+    out.append('')
+    out.append('namespace graphics {')
+    out.append('\tnamespace shaders {')
+    out.append('')
+    for program in programs:
+        # programs fed only through uniform blocks get no interface
+        if program.uniforms:
+            emit_program(program, out)
+    out.append('\t\t// std140 uniform blocks, offsets in bytes')
+    out.append('')
+    asserts = []
+    blocks = {}
+    for program in programs:
+        for name, (binding, members) in sorted(program.blocks.items(), key=lambda block: block[1][0] if block[1][0] is not None else 99):
+            if name in blocks and blocks[name] != (binding, members):
+                sys.exit('uniform block %s differs between programs' % name)
+            if name not in blocks:
+                blocks[name] = (binding, members)
+                emit_layout(program, name, binding, members, out, asserts)
+    while out[-1] == '':
+        out.pop()
+    out.append('\t}')
+    out.append('')
+    out.append('\t// the C++ mirrors have to follow the GLSL blocks byte for byte')
+    out.extend(line for line in asserts if not line.startswith('//'))
+    out.append('}')
+
+    with open(OUTPUT, 'w', newline='\n') as header:
+        header.write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+    main()